@@ -0,0 +1,40 @@
+#include "../benchmark/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+std::atomic<size_t> allocated_bytes{0};
+}
+
+namespace bench{
+
+size_t AllocationCount(){
+    return allocation_count.load();
+}
+
+size_t AllocatedBytes(){
+    return allocated_bytes.load();
+}
+
+}
+
+// Array forms call these by default
+void* operator new(std::size_t size){
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* pointer = std::malloc(size == 0 ? 1 : size)){
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept{
+    std::free(pointer);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Global operator new of the benchmark counts every allocation. The replacement lives in its
+// own translation unit, so no caller ever sees malloc and free inlined into new and delete
+namespace bench{
+
+size_t AllocationCount();
+size_t AllocatedBytes();
+
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../benchmark/city_generator.h"
+#include "../src/json.h"
+#include "../src/json_reader.h"
+#include "../src/map_renderer.h"
+#include "../src/transport_catalogue.h"
+
+using namespace std::string_literals;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options{
+    bench::CityConfig city;
+    std::vector<int> scales = {1};
+    int repeat = 3;
+    std::string output_path;
+};
+
+struct PhaseResult{
+    double best_ms = -1;
+
+    void Add(double ms){
+        if(best_ms < 0 || ms < best_ms){
+            best_ms = ms;
+        }
+    }
+};
+
+double ElapsedMs(Clock::time_point start){
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+json::Dict LatencyToJson(std::vector<double> latencies_us){
+    if(latencies_us.empty()){
+        return json::Dict{{"count", 0}};
+    }
+    std::sort(latencies_us.begin(), latencies_us.end());
+
+    double total = 0;
+    for(double latency : latencies_us){
+        total += latency;
+    }
+    auto percentile = [&latencies_us](double share){
+        size_t index = static_cast<size_t>(share * (latencies_us.size() - 1));
+        return latencies_us[index];
+    };
+
+    return json::Dict{
+        {"count", static_cast<int>(latencies_us.size())},
+        {"mean_us", total / latencies_us.size()},
+        {"p50_us", percentile(0.5)},
+        {"p99_us", percentile(0.99)},
+        {"max_us", latencies_us.back()}
+    };
+}
+
+std::vector<int> ParseScales(const std::string& text){
+    std::vector<int> scales;
+    std::stringstream input(text);
+    for(std::string scale; std::getline(input, scale, ',');){
+        scales.push_back(std::stoi(scale));
+    }
+    return scales;
+}
+
+void PrintUsage(){
+    std::cerr << "Usage: transport_catalogue_benchmark [options]\n"
+                 "  --seed N            generator seed (42)\n"
+                 "  --stops N           stops at scale 1 (1000)\n"
+                 "  --buses N           buses at scale 1 (100)\n"
+                 "  --route-length N    stops per bus request (20)\n"
+                 "  --density X         extra road distances per stop (1.0)\n"
+                 "  --queries N         Bus and Stop requests at scale 1 (1000)\n"
+                 "  --bus-share X       share of Bus requests among them (0.5)\n"
+                 "  --missing-share X   share of requests for unknown names (0.05)\n"
+                 "  --maps N            Map requests (1)\n"
+                 "  --scales A,B,...    multipliers for stops, buses and queries (1)\n"
+                 "  --repeat N          runs per scale, best time is reported (3)\n"
+                 "  --output FILE       write JSON results to FILE instead of stdout\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options){
+    for(int i = 1; i < argc; ++i){
+        std::string flag = argv[i];
+        if(flag == "--help" || i + 1 >= argc){
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if(flag == "--seed") options.city.seed = std::stoull(value);
+        else if(flag == "--stops") options.city.stop_count = std::stoi(value);
+        else if(flag == "--buses") options.city.bus_count = std::stoi(value);
+        else if(flag == "--route-length") options.city.route_length = std::stoi(value);
+        else if(flag == "--density") options.city.distance_density = std::stod(value);
+        else if(flag == "--queries") options.city.query_count = std::stoi(value);
+        else if(flag == "--bus-share") options.city.bus_query_share = std::stod(value);
+        else if(flag == "--missing-share") options.city.missing_query_share = std::stod(value);
+        else if(flag == "--maps") options.city.map_query_count = std::stoi(value);
+        else if(flag == "--scales") options.scales = ParseScales(value);
+        else if(flag == "--repeat") options.repeat = std::max(1, std::stoi(value));
+        else if(flag == "--output") options.output_path = value;
+        else return false;
+    }
+    return true;
+}
+
+json::Dict RunScale(const Options& options, int scale){
+    const bench::CityConfig city = options.city.Scaled(scale);
+
+    auto start = Clock::now();
+    json::Document generated = bench::GenerateCity(city);
+    std::ostringstream input_text;
+    json::Print(generated, input_text);
+    const std::string input = input_text.str();
+    std::cerr << "scale " << scale << ": generated " << input.size() << " bytes in " << ElapsedMs(start) << " ms\n";
+
+    PhaseResult parse, ingest, map_render, stat_requests, serialize;
+    std::vector<double> bus_latencies, stop_latencies;
+    size_t map_bytes = 0;
+    size_t output_bytes = 0;
+
+    for(int run = 0; run < options.repeat; ++run){
+        // JSON parse
+        start = Clock::now();
+        std::istringstream input_stream(input);
+        json::Document document = json::Load(input_stream);
+        parse.Add(ElapsedMs(start));
+
+        const json::Dict& root = document.GetRoot().AsDict();
+
+        // Catalogue ingest
+        transport_catalogue::TransportCatalogue catalogue;
+        JsonReader reader;
+
+        start = Clock::now();
+        reader.ReadBaseRequests(root.at("base_requests"), catalogue);
+        ingest.Add(ElapsedMs(start));
+        reader.ReadRenderSettings(root.at("render_settings"));
+
+        // Single query latency, straight against the catalogue
+        for(const auto& request : root.at("stat_requests").AsArray()){
+            const json::Dict& query = request.AsDict();
+            const std::string& type = query.at("type").AsString();
+
+            if(type == "Bus"){
+                auto query_start = Clock::now();
+                entities::BusRoute route = catalogue.RouteInformation(query.at("name").AsString());
+                bus_latencies.push_back(ElapsedMs(query_start) * 1000.0);
+                (void)route;
+            }else if(type == "Stop"){
+                auto query_start = Clock::now();
+                entities::StopBusList stop = catalogue.StopInformation(query.at("name").AsString());
+                stop_latencies.push_back(ElapsedMs(query_start) * 1000.0);
+                (void)stop;
+            }
+        }
+
+        // Map render
+        if(city.map_query_count > 0){
+            map::MapRender renderer;
+            renderer.SetRenderSettings(root.at("render_settings").AsDict());
+
+            start = Clock::now();
+            renderer.AddRenderData(catalogue.GetRenderData(), catalogue.GetStopCoordinates());
+            std::ostringstream map_stream;
+            renderer.RenderObjects(map_stream);
+            map_render.Add(ElapsedMs(start));
+            map_bytes = map_stream.str().size();
+        }
+
+        // Whole stat_requests section and the response serialization
+        start = Clock::now();
+        reader.ReadStatRequests(root.at("stat_requests"), catalogue);
+        stat_requests.Add(ElapsedMs(start));
+
+        start = Clock::now();
+        std::ostringstream output;
+        reader.PrintData(output);
+        serialize.Add(ElapsedMs(start));
+        output_bytes = output.str().size();
+    }
+
+    return json::Dict{
+        {"scale", scale},
+        {"stops", city.stop_count},
+        {"buses", city.bus_count},
+        {"queries", city.query_count},
+        {"input_bytes", static_cast<int>(input.size())},
+        {"output_bytes", static_cast<int>(output_bytes)},
+        {"map_bytes", static_cast<int>(map_bytes)},
+        {"parse_ms", parse.best_ms},
+        {"ingest_ms", ingest.best_ms},
+        {"map_render_ms", map_render.best_ms},
+        {"stat_requests_ms", stat_requests.best_ms},
+        {"serialize_ms", serialize.best_ms},
+        {"bus_query", LatencyToJson(std::move(bus_latencies))},
+        {"stop_query", LatencyToJson(std::move(stop_latencies))}
+    };
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if(!ParseOptions(argc, argv, options)){
+        PrintUsage();
+        return 1;
+    }
+
+    json::Array results;
+    for(int scale : options.scales){
+        results.emplace_back(RunScale(options, scale));
+    }
+
+    json::Document report{json::Dict{
+        {"seed", std::to_string(options.city.seed)},
+        {"repeat", options.repeat},
+        {"route_length", options.city.route_length},
+        {"distance_density", options.city.distance_density},
+        {"bus_query_share", options.city.bus_query_share},
+        {"results", std::move(results)}
+    }};
+
+    if(options.output_path.empty()){
+        json::Print(report, std::cout);
+        std::cout << std::endl;
+    }else{
+        std::ofstream output(options.output_path);
+        json::Print(report, output);
+        output << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "../benchmark/city_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "../src/geo.h"
+
+namespace bench{
+using namespace std::string_literals;
+
+namespace {
+
+const double CITY_LAT = 55.60;
+const double CITY_LNG = 37.40;
+const double CITY_SIZE = 0.3; // degrees
+
+struct StopGrid{
+    int side = 1;
+    std::vector<geo::Coordinates> locations;
+
+    int Neighbour(int stop, Random& random) const {
+        const int row = stop / side;
+        const int col = stop % side;
+        const int count = static_cast<int>(locations.size());
+
+        for(int attempt = 0; attempt < 8; ++attempt){
+            int next_row = row + random.NextInt(3) - 1;
+            int next_col = col + random.NextInt(3) - 1;
+            int next = next_row * side + next_col;
+
+            if(next_row >= 0 && next_col >= 0 && next_col < side && next < count && next != stop){
+                return next;
+            }
+        }
+        return (stop + 1) % count;
+    }
+};
+
+StopGrid MakeGrid(const CityConfig& config, Random& random){
+    StopGrid grid;
+    grid.side = std::max(1, static_cast<int>(std::ceil(std::sqrt(config.stop_count))));
+    const double step = CITY_SIZE / grid.side;
+
+    grid.locations.reserve(config.stop_count);
+    for(int i = 0; i < config.stop_count; ++i){
+        int row = i / grid.side;
+        int col = i % grid.side;
+        grid.locations.push_back({CITY_LAT + (row + 0.8 * random.NextDouble()) * step,
+                                  CITY_LNG + (col + 0.8 * random.NextDouble()) * step});
+    }
+    return grid;
+}
+
+void AddRoadDistance(std::vector<std::map<int, int>>& road_distances, const StopGrid& grid,
+                     int from, int to, Random& random){
+    if(road_distances[to].count(from)){
+        return;
+    }
+    double distance = geo::ComputeDistance(grid.locations[from], grid.locations[to]);
+    road_distances[from].emplace(to, static_cast<int>(std::ceil(distance * (1.1 + 0.4 * random.NextDouble()))));
+}
+
+json::Dict MakeRenderSettings(){
+    return json::Dict{
+        {"width", 1200.0},
+        {"height", 1200.0},
+        {"padding", 50.0},
+        {"line_width", 14.0},
+        {"stop_radius", 5.0},
+        {"bus_label_font_size", 20},
+        {"bus_label_offset", json::Array{7.0, 15.0}},
+        {"stop_label_font_size", 18},
+        {"stop_label_offset", json::Array{7.0, -3.0}},
+        {"underlayer_color", json::Array{255, 255, 255, 0.85}},
+        {"underlayer_width", 3.0},
+        {"color_palette", json::Array{"green"s, json::Array{255, 160, 0}, "red"s}}
+    };
+}
+}
+
+CityConfig CityConfig::Scaled(int scale) const{
+    CityConfig result = *this;
+    result.stop_count *= scale;
+    result.bus_count *= scale;
+    result.query_count *= scale;
+    return result;
+}
+
+// ---------------- Random --------------------------
+uint64_t Random::Next(){
+    // splitmix64
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+int Random::NextInt(int bound){
+    return bound <= 0 ? 0 : static_cast<int>(Next() % static_cast<uint64_t>(bound));
+}
+
+double Random::NextDouble(){
+    return (Next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+std::string StopName(int id){
+    return "Stop " + std::to_string(id);
+}
+
+std::string BusName(int id){
+    return "Bus " + std::to_string(id);
+}
+
+// ---------------- City --------------------------
+json::Document GenerateCity(const CityConfig& config){
+    Random random(config.seed);
+    StopGrid grid = MakeGrid(config, random);
+    std::vector<std::map<int, int>> road_distances(config.stop_count);
+
+    json::Array base_requests;
+    base_requests.reserve(config.stop_count + config.bus_count);
+
+    // Bus routes
+    for(int bus = 0; bus < config.bus_count && config.stop_count > 1; ++bus){
+        bool is_roundtrip = random.NextDouble() < config.roundtrip_share;
+        int length = std::max(2, config.route_length);
+
+        std::vector<int> route = {random.NextInt(config.stop_count)};
+        while(static_cast<int>(route.size()) < length - (is_roundtrip ? 1 : 0)){
+            route.push_back(grid.Neighbour(route.back(), random));
+        }
+        if(is_roundtrip){
+            if(route.size() > 1 && route.back() == route.front()){
+                route.pop_back();
+            }
+            route.push_back(route.front());
+        }
+
+        json::Array stops;
+        stops.reserve(route.size());
+        for(size_t i = 0; i < route.size(); ++i){
+            stops.push_back(StopName(route[i]));
+            // Catalogue fills in the opposite direction on its own
+            if(i > 0){
+                AddRoadDistance(road_distances, grid, route[i - 1], route[i], random);
+            }
+        }
+
+        base_requests.push_back(json::Dict{
+            {"type", "Bus"s},
+            {"name", BusName(bus)},
+            {"stops", std::move(stops)},
+            {"is_roundtrip", is_roundtrip}
+        });
+    }
+
+    // Stops with extra road distances to random neighbours
+    for(int stop = 0; stop < config.stop_count; ++stop){
+        double extra = config.distance_density;
+        while(extra > 0 && config.stop_count > 1){
+            if(extra >= 1.0 || random.NextDouble() < extra){
+                AddRoadDistance(road_distances, grid, stop, grid.Neighbour(stop, random), random);
+            }
+            extra -= 1.0;
+        }
+
+        json::Dict distances;
+        for(const auto& [to, distance] : road_distances[stop]){
+            distances.emplace(StopName(to), distance);
+        }
+
+        base_requests.push_back(json::Dict{
+            {"type", "Stop"s},
+            {"name", StopName(stop)},
+            {"latitude", grid.locations[stop].lat},
+            {"longitude", grid.locations[stop].lng},
+            {"road_distances", std::move(distances)}
+        });
+    }
+
+    // Queries, maps are spread evenly between the others
+    json::Array stat_requests;
+    stat_requests.reserve(config.query_count + config.map_query_count);
+
+    const int total_queries = config.query_count + config.map_query_count;
+    for(int id = 1, maps = 0; id <= total_queries; ++id){
+        if(maps < config.map_query_count
+           && static_cast<long long>(id) * config.map_query_count >= static_cast<long long>(maps + 1) * total_queries){
+            stat_requests.push_back(json::Dict{{"id", id}, {"type", "Map"s}});
+            ++maps;
+            continue;
+        }
+
+        bool is_bus = random.NextDouble() < config.bus_query_share;
+        bool is_missing = random.NextDouble() < config.missing_query_share;
+        int count = is_bus ? config.bus_count : config.stop_count;
+
+        std::string name = is_bus ? BusName(random.NextInt(count)) : StopName(random.NextInt(count));
+        if(is_missing){
+            name = "Missing " + name;
+        }
+
+        stat_requests.push_back(json::Dict{
+            {"id", id},
+            {"type", is_bus ? "Bus"s : "Stop"s},
+            {"name", std::move(name)}
+        });
+    }
+
+    return json::Document{json::Dict{
+        {"base_requests", std::move(base_requests)},
+        {"render_settings", MakeRenderSettings()},
+        {"stat_requests", std::move(stat_requests)}
+    }};
+}
+}
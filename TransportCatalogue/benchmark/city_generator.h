@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../src/json.h"
+
+namespace bench{
+
+struct CityConfig{
+    uint64_t seed = 42;
+
+    int stop_count = 1000;
+    int bus_count = 100;
+    int route_length = 20; // stops listed in a bus request
+    double roundtrip_share = 0.5;
+    double distance_density = 1.0; // road_distances per stop on top of the route segments
+
+    int query_count = 1000;
+    double bus_query_share = 0.5; // the rest are Stop requests
+    double missing_query_share = 0.05; // requests for names not in the catalogue
+    int map_query_count = 1;
+
+    CityConfig Scaled(int scale) const;
+};
+
+// Small deterministic generator, standard distributions differ between
+// library implementations and would change the city from one compiler to another
+class Random{
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t Next();
+    int NextInt(int bound); // [0, bound)
+    double NextDouble(); // [0, 1)
+
+private:
+    uint64_t state_;
+};
+
+std::string StopName(int id);
+std::string BusName(int id);
+
+// Stops are laid on a jittered grid about 30 km wide, buses take random walks
+// between neighbouring stops. Every route segment gets a road distance.
+json::Document GenerateCity(const CityConfig& config);
+}
@@ -0,0 +1,265 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../benchmark/allocation_counter.h"
+#include "../benchmark/city_generator.h"
+#include "../src/json.h"
+#include "../src/json_builder.h"
+
+using namespace std::string_literals;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options{
+    int scale = 1;
+    int repeat = 5;
+    std::string output_path;
+};
+
+struct Measurement{
+    double best_ms = -1;
+    double allocations = 0;
+    double allocated_bytes = 0;
+};
+
+// Runs body repeat times, keeps the best time and the average allocations per run
+Measurement Measure(int repeat, const std::function<void()>& body){
+    Measurement result;
+    for(int run = 0; run < repeat; ++run){
+        size_t count_before = bench::AllocationCount();
+        size_t bytes_before = bench::AllocatedBytes();
+
+        auto start = Clock::now();
+        body();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        result.allocations += bench::AllocationCount() - count_before;
+        result.allocated_bytes += bench::AllocatedBytes() - bytes_before;
+        if(result.best_ms < 0 || ms < result.best_ms){
+            result.best_ms = ms;
+        }
+    }
+    result.allocations /= repeat;
+    result.allocated_bytes /= repeat;
+    return result;
+}
+
+// ---------------- Corpus --------------------------
+json::Node DeepRoadDistances(int scale, bench::Random& random){
+    json::Array stops;
+    for(int stop = 0; stop < 20 * scale; ++stop){
+        json::Dict distances;
+        for(int i = 0; i < 200; ++i){
+            distances.emplace(bench::StopName(random.NextInt(100000)), random.NextInt(50000));
+        }
+        stops.push_back(json::Dict{
+            {"type", "Stop"s},
+            {"name", bench::StopName(stop)},
+            {"latitude", 55.5 + random.NextDouble()},
+            {"longitude", 37.3 + random.NextDouble()},
+            {"road_distances", std::move(distances)}
+        });
+    }
+    return json::Dict{{"base_requests", std::move(stops)}};
+}
+
+json::Node LongStopArrays(int scale, bench::Random& random){
+    json::Array buses;
+    for(int bus = 0; bus < 10 * scale; ++bus){
+        json::Array stops;
+        for(int i = 0; i < 2000; ++i){
+            stops.push_back(bench::StopName(random.NextInt(100000)));
+        }
+        buses.push_back(json::Dict{
+            {"type", "Bus"s},
+            {"name", bench::BusName(bus)},
+            {"stops", std::move(stops)},
+            {"is_roundtrip", random.NextInt(2) == 0}
+        });
+    }
+    return json::Dict{{"base_requests", std::move(buses)}};
+}
+
+json::Node EmbeddedSvg(int scale, bench::Random& random){
+    // Same shape as a Map response: one huge string full of escaped quotes
+    std::string map = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\\n<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\\n"s;
+    for(int i = 0; i < 20000 * scale; ++i){
+        map += "  <circle cx=\""s + std::to_string(random.NextDouble() * 1200) + "\" cy=\""s
+            + std::to_string(random.NextDouble() * 1200) + "\" r=\"5\" fill=\"white\"/>\\n"s;
+    }
+    map += "</svg>"s;
+
+    return json::Array{json::Dict{{"map", std::move(map)}, {"request_id", 1}}};
+}
+
+json::Node NumberArrays(int scale, bench::Random& random){
+    json::Array responses;
+    for(int i = 0; i < 20000 * scale; ++i){
+        responses.push_back(json::Dict{
+            {"curvature", 1.0 + random.NextDouble()},
+            {"request_id", i},
+            {"route_length", random.NextInt(1000000)},
+            {"stop_count", random.NextInt(100)},
+            {"unique_stop_count", random.NextInt(50)}
+        });
+    }
+    return responses;
+}
+
+std::string ToText(const json::Node& node){
+    std::ostringstream output;
+    json::Print(json::Document{node}, output);
+    return output.str();
+}
+
+// ---------------- Report --------------------------
+json::Dict ThroughputToJson(const Measurement& measurement, size_t bytes){
+    double seconds = measurement.best_ms / 1000.0;
+    return json::Dict{
+        {"ms", measurement.best_ms},
+        {"mb_per_s", bytes / (1024.0 * 1024.0) / seconds},
+        {"allocations", measurement.allocations},
+        {"allocated_bytes", measurement.allocated_bytes}
+    };
+}
+
+json::Dict RunDocument(const std::string& name, const json::Node& node, int repeat){
+    const std::string text = ToText(node);
+
+    Measurement parse = Measure(repeat, [&text](){
+        std::istringstream input(text);
+        json::Document document = json::Load(input);
+    });
+
+    json::Document document{node};
+    Measurement print = Measure(repeat, [&document](){
+        std::ostringstream output;
+        json::Print(document, output);
+    });
+
+    std::cerr << name << ": " << text.size() << " bytes, parse " << parse.best_ms << " ms, print "
+              << print.best_ms << " ms\n";
+
+    return json::Dict{
+        {"document", name},
+        {"bytes", static_cast<int>(text.size())},
+        {"parse", ThroughputToJson(parse, text.size())},
+        {"print", ThroughputToJson(print, text.size())}
+    };
+}
+
+// Response array of Bus answers built element by element through json::Builder,
+// into a tree and printed straight to a buffer, body gets the builder once the array is closed
+template <typename Body>
+void BuildResponses(json::Builder& builder, int count, Body after){
+    builder.StartArray();
+    for(int i = 0; i < count; ++i){
+        builder.StartDict()
+            .Key("curvature"s).Value(1.5)
+            .Key("request_id"s).Value(i)
+            .Key("route_length"s).Value(27600)
+            .EndDict();
+    }
+    builder.EndArray();
+    after(builder);
+}
+
+json::Dict RunBuilder(int scale, int repeat){
+    const int count = 2000 * scale;
+
+    Measurement build = Measure(repeat, [count](){
+        json::Builder builder;
+        BuildResponses(builder, count, [](json::Builder& built){
+            built.Build();
+        });
+    });
+
+    Measurement build_print = Measure(repeat, [count](){
+        std::ostringstream output;
+        json::Builder builder;
+        BuildResponses(builder, count, [&output](json::Builder& built){
+            json::Print(json::Document(built.Build()), output);
+        });
+    });
+
+    Measurement stream = Measure(repeat, [count](){
+        std::ostringstream output;
+        json::Builder builder(output);
+        BuildResponses(builder, count, [](json::Builder& built){
+            built.Build();
+        });
+    });
+
+    std::cerr << "builder: " << count << " dicts in " << build.best_ms << " ms, built and printed in "
+              << build_print.best_ms << " ms, streamed in " << stream.best_ms << " ms\n";
+
+    return json::Dict{
+        {"document", "builder_responses"s},
+        {"elements", count},
+        {"ms", build.best_ms},
+        {"allocations", build.allocations},
+        {"allocated_bytes", build.allocated_bytes},
+        {"build_print_ms", build_print.best_ms},
+        {"stream_ms", stream.best_ms},
+        {"stream_allocations", stream.allocations}
+    };
+}
+
+void PrintUsage(){
+    std::cerr << "Usage: json_benchmark [--scale N] [--repeat N] [--output FILE]\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options){
+    for(int i = 1; i < argc; ++i){
+        std::string flag = argv[i];
+        if(flag == "--help" || i + 1 >= argc){
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if(flag == "--scale") options.scale = std::max(1, std::stoi(value));
+        else if(flag == "--repeat") options.repeat = std::max(1, std::stoi(value));
+        else if(flag == "--output") options.output_path = value;
+        else return false;
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if(!ParseOptions(argc, argv, options)){
+        PrintUsage();
+        return 1;
+    }
+
+    bench::Random random(42);
+    json::Array results;
+    results.push_back(RunDocument("road_distances"s, DeepRoadDistances(options.scale, random), options.repeat));
+    results.push_back(RunDocument("stop_arrays"s, LongStopArrays(options.scale, random), options.repeat));
+    results.push_back(RunDocument("embedded_svg"s, EmbeddedSvg(options.scale, random), options.repeat));
+    results.push_back(RunDocument("number_arrays"s, NumberArrays(options.scale, random), options.repeat));
+    results.push_back(RunBuilder(options.scale, options.repeat));
+
+    json::Document report{json::Dict{
+        {"scale", options.scale},
+        {"repeat", options.repeat},
+        {"results", std::move(results)}
+    }};
+
+    if(options.output_path.empty()){
+        json::Print(report, std::cout);
+        std::cout << std::endl;
+    }else{
+        std::ofstream output(options.output_path);
+        json::Print(report, output);
+        output << std::endl;
+    }
+    return 0;
+}
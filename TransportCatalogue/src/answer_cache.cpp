@@ -0,0 +1,47 @@
+#include "../src/answer_cache.h"
+
+namespace answers{
+
+namespace {
+const std::string_view REQUEST_ID_MARKER = "\"request_id\": ";
+const std::string_view REQUEST_ID_PLACEHOLDER = "0";
+}
+
+void AnswerCache::AddAnswer(const std::string& answer, Shard& shard){
+    // Quotes inside strings are escaped, the marker can only be the key itself
+    const size_t marker = answer.find(REQUEST_ID_MARKER);
+    if(marker == std::string::npos
+       || answer.compare(marker + REQUEST_ID_MARKER.size(), REQUEST_ID_PLACEHOLDER.size(), REQUEST_ID_PLACEHOLDER) != 0){
+        throw std::logic_error("Answer has no request_id to replace");
+    }
+
+    Entry entry;
+    entry.offset = shard.arena.size();
+    entry.prefix_size = static_cast<uint32_t>(marker + REQUEST_ID_MARKER.size());
+    entry.suffix_size = static_cast<uint32_t>(answer.size() - entry.prefix_size - REQUEST_ID_PLACEHOLDER.size());
+
+    shard.arena.append(answer, 0, entry.prefix_size);
+    shard.arena.append(answer, entry.prefix_size + REQUEST_ID_PLACEHOLDER.size(), std::string::npos);
+    shard.entries.push_back(entry);
+}
+
+bool AnswerCache::Append(std::string_view name, int request_id, std::string& output) const{
+    const uint32_t* index = index_.Find(name);
+    if(index == nullptr){
+        return false;
+    }
+    const Entry& entry = entries_[*index];
+    output.append(arena_, entry.offset, entry.prefix_size);
+    output += std::to_string(request_id);
+    output.append(arena_, entry.offset + entry.prefix_size, entry.suffix_size);
+    return true;
+}
+
+size_t AnswerCache::Size() const{
+    return entries_.size();
+}
+
+size_t AnswerCache::HeapUsage() const{
+    return memory::HeapUsage(arena_) + memory::HeapUsage(entries_) + index_.HeapUsage();
+}
+}
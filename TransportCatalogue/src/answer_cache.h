@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../src/memory_usage.h"
+#include "../src/parallel.h"
+#include "../src/perfect_hash.h"
+
+namespace answers{
+
+// Printed answers of a fixed set of names, kept in one arena. Every answer is stored as the
+// text before its request_id value and the text after it, so answering is copying the two
+// pieces around the id of the request.
+class AnswerCache{
+public:
+    // format(index) returns the printed answer for names[index] with "request_id": 0.
+    // Answers are formatted on thread_count threads, names must outlive the cache
+    template <typename Format>
+    void Build(const std::vector<std::string_view>& names, unsigned thread_count, Format format);
+
+    // Appends the answer for name with request_id spliced in, false when name is not cached
+    bool Append(std::string_view name, int request_id, std::string& output) const;
+
+    size_t Size() const;
+    size_t HeapUsage() const;
+
+private:
+    struct Entry{
+        size_t offset = 0; // of the text before the id in arena_
+        uint32_t prefix_size = 0;
+        uint32_t suffix_size = 0;
+    };
+
+    struct Shard{
+        std::string arena;
+        std::vector<Entry> entries;
+    };
+
+    // Splits an answer at its request_id value
+    static void AddAnswer(const std::string& answer, Shard& shard);
+
+private:
+    std::string arena_;
+    std::vector<Entry> entries_;
+    flat::PerfectHashMap<uint32_t> index_;
+};
+
+template <typename Format>
+void AnswerCache::Build(const std::vector<std::string_view>& names, unsigned thread_count, Format format){
+    thread_count = std::max(1u, std::min<unsigned>(thread_count, static_cast<unsigned>(names.size())));
+
+    // Thread i formats a contiguous range of names into its own arena
+    std::vector<Shard> shards(thread_count);
+    parallel::RunTasks(thread_count, [&](unsigned shard){
+        const size_t begin = names.size() * shard / thread_count;
+        const size_t end = names.size() * (shard + 1) / thread_count;
+        for(size_t index = begin; index < end; ++index){
+            AddAnswer(format(index), shards[shard]);
+        }
+    });
+
+    size_t arena_size = 0;
+    for(const auto& shard : shards){
+        arena_size += shard.arena.size();
+    }
+    arena_.clear();
+    arena_.reserve(arena_size);
+    entries_.clear();
+    entries_.reserve(names.size());
+    for(auto& shard : shards){
+        for(Entry entry : shard.entries){
+            entry.offset += arena_.size();
+            entries_.push_back(entry);
+        }
+        arena_ += shard.arena;
+        shard = {};
+    }
+
+    std::vector<std::pair<std::string_view, uint32_t>> keys;
+    keys.reserve(names.size());
+    for(size_t index = 0; index < names.size(); ++index){
+        keys.emplace_back(names[index], static_cast<uint32_t>(index));
+    }
+    index_.Build(keys);
+}
+}
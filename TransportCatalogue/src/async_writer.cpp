@@ -0,0 +1,97 @@
+#include "../src/async_writer.h"
+
+namespace io{
+
+AsyncWriter::AsyncWriter(std::ostream& sink, size_t buffer_size, size_t buffer_count)
+    : sink_(sink)
+    , buffers_(std::max<size_t>(2, buffer_count), std::vector<char>(std::max<size_t>(1, buffer_size))) {
+    for(size_t buffer = 1; buffer < buffers_.size(); ++buffer){
+        free_.push_back(buffer);
+    }
+    setp(buffers_[current_].data(), buffers_[current_].data() + buffers_[current_].size());
+    writer_ = std::thread([this](){
+        Run();
+    });
+}
+
+AsyncWriter::~AsyncWriter(){
+    sync();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    writer_.join();
+}
+
+AsyncWriter::int_type AsyncWriter::overflow(int_type c){
+    if(!Submit()){
+        return traits_type::eof();
+    }
+    if(!traits_type::eq_int_type(c, traits_type::eof())){
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int AsyncWriter::sync(){
+    if(!Submit()){
+        return -1;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this](){
+        return full_.empty() && !writing_;
+    });
+    // The writer is idle until the next Submit
+    if(!failed_ && !sink_.flush()){
+        failed_ = true;
+    }
+    return failed_ ? -1 : 0;
+}
+
+bool AsyncWriter::Submit(){
+    const size_t size = pptr() - pbase();
+    if(size > 0){
+        std::unique_lock<std::mutex> lock(mutex_);
+        full_.push_back({current_, size});
+        changed_.notify_all();
+
+        changed_.wait(lock, [this](){
+            return !free_.empty();
+        });
+        current_ = free_.front();
+        free_.pop_front();
+    }
+    setp(buffers_[current_].data(), buffers_[current_].data() + buffers_[current_].size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !failed_;
+}
+
+void AsyncWriter::Run(){
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true){
+        changed_.wait(lock, [this](){
+            return !full_.empty() || stopping_;
+        });
+        if(full_.empty()){
+            return;
+        }
+
+        const Chunk chunk = full_.front();
+        full_.pop_front();
+        writing_ = true;
+        lock.unlock();
+
+        const bool written = static_cast<bool>(sink_.write(buffers_[chunk.buffer].data(), chunk.size));
+
+        lock.lock();
+        writing_ = false;
+        failed_ = failed_ || !written;
+        free_.push_back(chunk.buffer);
+        changed_.notify_all();
+    }
+}
+}
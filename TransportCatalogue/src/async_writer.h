@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace io{
+
+// Stream buffer that hands its output to a writer thread. Text is collected in one of several
+// large buffers; a full buffer goes to the writer, which passes it to the sink in a single write
+// call, while the next free buffer is being filled. Writing blocks only when every buffer is waiting.
+// Flushing the stream waits until all text so far has reached the sink and flushes the sink.
+class AsyncWriter : public std::streambuf{
+public:
+    explicit AsyncWriter(std::ostream& sink, size_t buffer_size = 1 << 20, size_t buffer_count = 2);
+    // Writes out the rest of the text
+    ~AsyncWriter() override;
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    struct Chunk{
+        size_t buffer;
+        size_t size;
+    };
+
+    // Queues the filled part of the current buffer and switches to a free one
+    bool Submit();
+    void Run();
+
+private:
+    std::ostream& sink_;
+    std::vector<std::vector<char>> buffers_;
+    size_t current_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Chunk> full_;
+    std::deque<size_t> free_;
+    bool writing_ = false;
+    bool stopping_ = false;
+    bool failed_ = false;
+
+    std::thread writer_;
+};
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <set>
 #include <string>
 #include <string_view>
@@ -11,19 +12,36 @@ namespace entities{
 
 struct Stop{
     std::string name;
-    geo::Coordinates location;
+    uint32_t id = 0; // position in catalogue, indexes per stop arrays such as coordinates
 };
 
 using StopPtr = const Stop*;
 
 struct Bus{
     std::string name;
-    std::vector<StopPtr> stops;
+    std::vector<StopPtr> stops; // a bus that is not circular goes to the last stop and back, only the way there is kept
     bool is_circular = false;
+    uint32_t id = 0; // position in catalogue
 };
 
 using BusPtr = const Bus*;
 
+// Stops of the whole trip, the way back included
+inline size_t RouteStopCount(const Bus& bus){
+    if(bus.is_circular || bus.stops.empty()){
+        return bus.stops.size();
+    }
+    return 2 * bus.stops.size() - 1;
+}
+
+// Stop at a position of the whole trip, position < RouteStopCount(bus)
+inline StopPtr RouteStop(const Bus& bus, size_t position){
+    if(position < bus.stops.size()){
+        return bus.stops[position];
+    }
+    return bus.stops[2 * bus.stops.size() - 2 - position];
+}
+
 struct StopBusList{
     std::string stop;
     bool buses_exist = false;
@@ -38,10 +56,58 @@ struct BusRoute {
     double route_curvature = 0;
 };
 
+// Part of a bus trip between two of its stops
+struct RouteSegment{
+    bool found = false;
+    int route_length = 0;
+    int stop_count = 0; // both ends included
+};
+
+struct NearbyStop{
+    StopPtr stop = nullptr;
+    double distance = 0.0;
+};
+
+struct AreaObjectList{
+    std::set<std::string_view> stops;
+    std::set<std::string_view> buses;
+};
+
+struct CommonBusList{
+    bool stops_exist = false;
+    std::set<std::string_view> buses;
+};
+
+struct ReachableBus{
+    std::string_view name;
+    uint32_t transfers = 0;
+};
+
+struct TransferReach{
+    bool stop_exists = false;
+    std::vector<ReachableBus> buses; // by name
+};
+
+struct NameMatch{
+    std::string_view name;
+    uint32_t rank = 0; // buses of a stop, unique stops of a bus
+};
+
+struct NameSuggestions{
+    std::vector<NameMatch> stops;
+    std::vector<NameMatch> buses;
+};
+
 struct BusRouteRenderInfo{
     std::string name;
-    std::vector<StopPtr> stops;
+    std::vector<StopPtr> stops; // way there only, as in Bus
     bool route_cirular = false;
+    size_t route_index = 0; // position among all rendered routes, picks the palette color
+};
+
+struct ViewportRenderInfo{
+    std::vector<BusRouteRenderInfo> routes;
+    std::vector<StopPtr> stops;
 };
 
 }
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "../src/memory_usage.h"
+
+namespace flat{
+
+// Spreads integer keys whose low bits are alike, std::hash leaves integers as they are
+struct IntegerHasher{
+    size_t operator()(uint64_t key) const {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+};
+
+// Open addressing hash table built once from all its entries and only read after that.
+// Entries sit in one array at most half full, a lookup hashes the key and scans the few
+// neighbouring slots, with no node allocations or pointer chasing.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap{
+public:
+    // Keys must be unique
+    void Build(const std::vector<std::pair<Key, Value>>& entries){
+        size_t capacity = 2;
+        while(capacity < 2 * entries.size()){
+            capacity *= 2;
+        }
+        slots_.assign(capacity, Slot{});
+        mask_ = capacity - 1;
+        size_ = entries.size();
+
+        for(const auto& [key, value] : entries){
+            size_t index = hasher_(key) & mask_;
+            while(slots_[index].used){
+                index = (index + 1) & mask_;
+            }
+            slots_[index] = {key, value, true};
+        }
+    }
+
+    const Value* Find(const Key& key) const {
+        if(slots_.empty()){
+            return nullptr;
+        }
+        for(size_t index = hasher_(key) & mask_; slots_[index].used; index = (index + 1) & mask_){
+            if(slots_[index].key == key){
+                return &slots_[index].value;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename Visitor>
+    void ForEach(Visitor visitor) const {
+        for(const auto& slot : slots_){
+            if(slot.used){
+                visitor(slot.key, slot.value);
+            }
+        }
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t HeapUsage() const {
+        return memory::HeapUsage(slots_);
+    }
+
+private:
+    struct Slot{
+        Key key{};
+        Value value{};
+        bool used = false;
+    };
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    Hash hasher_;
+};
+
+}
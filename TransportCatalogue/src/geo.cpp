@@ -1,11 +1,34 @@
-
 #define _USE_MATH_DEFINES
 #include "../src/geo.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace geo {
 
+namespace {
+
+const double DR = M_PI / 180.0;
+const double EARTH_RADIUS = 6371000;
+
+// Pairs are gathered in blocks that fit into L1 and handled by plain loops over
+// contiguous arrays, which the compiler can turn into SIMD code
+const size_t BLOCK_SIZE = 256;
+
+void ComputeBlock(const double* sin_lat1, const double* cos_lat1, const double* lng1,
+                  const double* sin_lat2, const double* cos_lat2, const double* lng2,
+                  double* result, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        double cos_angle = sin_lat1[i] * sin_lat2[i]
+                           + cos_lat1[i] * cos_lat2[i] * std::cos(std::abs(lng1[i] - lng2[i]) * DR);
+        // Rounding may push equal points slightly out of acos domain
+        cos_angle = std::min(1.0, std::max(-1.0, cos_angle));
+        result[i] = std::acos(cos_angle) * EARTH_RADIUS;
+    }
+}
+
+}  // namespace
+
 double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
     const double dr = M_PI / 180.0;
@@ -14,4 +37,87 @@ double ComputeDistance(Coordinates from, Coordinates to) {
         * 6371000;
 }
 
-}  // namespace geo
\ No newline at end of file
+// ---------- CoordinateTable ------------------
+
+void CoordinateTable::Set(size_t index, Coordinates point) {
+    if (index >= lat_.size()) {
+        lat_.resize(index + 1);
+        lng_.resize(index + 1);
+    }
+    lat_[index] = FromDegrees(point.lat);
+    lng_[index] = FromDegrees(point.lng);
+}
+
+size_t CoordinateTable::Size() const {
+    return lat_.size();
+}
+
+const CoordinateTable::Value* CoordinateTable::Lat() const {
+    return lat_.data();
+}
+
+const CoordinateTable::Value* CoordinateTable::Lng() const {
+    return lng_.data();
+}
+
+CoordinateTable::Value CoordinateTable::FromDegrees(double degrees) {
+#ifdef TC_FIXED_POINT_COORDINATES
+    return static_cast<Value>(std::lround(degrees / DEGREES_PER_UNIT));
+#else
+    return degrees;
+#endif
+}
+
+// ---------- TrigTable ------------------
+
+void TrigTable::Set(size_t index, Coordinates point) {
+    if (index >= lng_.size()) {
+        sin_lat_.resize(index + 1);
+        cos_lat_.resize(index + 1);
+        lng_.resize(index + 1);
+    }
+    sin_lat_[index] = std::sin(point.lat * DR);
+    cos_lat_[index] = std::cos(point.lat * DR);
+    lng_[index] = point.lng;
+}
+
+size_t TrigTable::Size() const {
+    return lng_.size();
+}
+
+const double* TrigTable::SinLat() const {
+    return sin_lat_.data();
+}
+
+const double* TrigTable::CosLat() const {
+    return cos_lat_.data();
+}
+
+const double* TrigTable::Lng() const {
+    return lng_.data();
+}
+
+// ---------- Batch distances ------------------
+
+void ComputeDistances(const TrigTable& points, const uint32_t* from, const uint32_t* to,
+                      double* result, size_t count) {
+    double sin_lat1[BLOCK_SIZE], cos_lat1[BLOCK_SIZE], lng1[BLOCK_SIZE];
+    double sin_lat2[BLOCK_SIZE], cos_lat2[BLOCK_SIZE], lng2[BLOCK_SIZE];
+
+    for (size_t begin = 0; begin < count; begin += BLOCK_SIZE) {
+        const size_t size = std::min(BLOCK_SIZE, count - begin);
+
+        for (size_t i = 0; i < size; ++i) {
+            sin_lat1[i] = points.SinLat()[from[begin + i]];
+            cos_lat1[i] = points.CosLat()[from[begin + i]];
+            lng1[i] = points.Lng()[from[begin + i]];
+
+            sin_lat2[i] = points.SinLat()[to[begin + i]];
+            cos_lat2[i] = points.CosLat()[to[begin + i]];
+            lng2[i] = points.Lng()[to[begin + i]];
+        }
+        ComputeBlock(sin_lat1, cos_lat1, lng1, sin_lat2, cos_lat2, lng2, result + begin, size);
+    }
+}
+
+}  // namespace geo
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace geo {
 
 struct Coordinates {
@@ -9,6 +13,57 @@ struct Coordinates {
 
 double ComputeDistance(Coordinates from, Coordinates to);
 
-}  // namespace geo
+// Coordinates of many points in two contiguous arrays, so geometric scans read no other data.
+// Builds with TC_FIXED_POINT_COORDINATES keep them as int32 in 1e-7 degree units, half the size
+class CoordinateTable {
+public:
+#ifdef TC_FIXED_POINT_COORDINATES
+    using Value = int32_t;
+    static constexpr double DEGREES_PER_UNIT = 1e-7;
+#else
+    using Value = double;
+    static constexpr double DEGREES_PER_UNIT = 1.0;
+#endif
+
+    void Set(size_t index, Coordinates point);
+    size_t Size() const;
+
+    Coordinates Get(size_t index) const {
+        return {ToDegrees(lat_[index]), ToDegrees(lng_[index])};
+    }
 
+    const Value* Lat() const;
+    const Value* Lng() const;
+
+    static double ToDegrees(Value value) {
+        return value * DEGREES_PER_UNIT;
+    }
+    static Value FromDegrees(double degrees);
+
+private:
+    std::vector<Value> lat_;
+    std::vector<Value> lng_;
+};
 
+// Points kept as struct of arrays with their latitude trigonometry computed once,
+// so batch distance loops only evaluate one cos and one acos per pair
+class TrigTable {
+public:
+    void Set(size_t index, Coordinates point);
+    size_t Size() const;
+
+    const double* SinLat() const;
+    const double* CosLat() const;
+    const double* Lng() const;
+
+private:
+    std::vector<double> sin_lat_;
+    std::vector<double> cos_lat_;
+    std::vector<double> lng_;
+};
+
+// result[i] = distance between points[from[i]] and points[to[i]]
+void ComputeDistances(const TrigTable& points, const uint32_t* from, const uint32_t* to,
+                      double* result, size_t count);
+
+}  // namespace geo
@@ -0,0 +1,284 @@
+#include "../src/instrumentation.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <new>
+
+namespace stats{
+
+namespace {
+
+thread_local AllocationCounter* current_allocations = nullptr;
+
+const int SUB_BUCKET_BITS = 4;
+const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+const uint64_t LINEAR_LIMIT = 2 * SUB_BUCKET_COUNT; // smaller values are stored exactly
+
+int HighestBit(uint64_t value){
+    int bit = 0;
+    while(value >>= 1){
+        ++bit;
+    }
+    return bit;
+}
+
+// Printer keeps 6 significant digits of doubles, so exact counts stay ints while they fit
+json::Node CounterToJson(uint64_t value){
+    if(value <= static_cast<uint64_t>(std::numeric_limits<int>::max())){
+        return static_cast<int>(value);
+    }
+    return static_cast<double>(value);
+}
+
+json::Dict MetricToJson(const Metric& metric, MetricKind kind){
+    const LatencyHistogram& histogram = metric.latency;
+
+    // Phases last milliseconds, single requests microseconds
+    const double unit = kind == MetricKind::PHASE ? 1e6 : 1e3;
+    const std::string suffix = kind == MetricKind::PHASE ? "_ms" : "_us";
+
+    json::Dict result{
+        {"count", CounterToJson(histogram.Count())},
+        {"total_ms", histogram.Total() / 1e6},
+        {"p50" + suffix, histogram.Percentile(0.5) / unit},
+        {"p99" + suffix, histogram.Percentile(0.99) / unit},
+        {"max" + suffix, histogram.Max() / unit}
+    };
+
+    if(IsAllocationTrackingCompiled()){
+        result.emplace("allocations", CounterToJson(metric.allocations.count));
+        result.emplace("allocated_bytes", CounterToJson(metric.allocations.bytes));
+        if(histogram.Count() > 0){
+            result.emplace("allocations_per_call", static_cast<double>(metric.allocations.count) / histogram.Count());
+        }
+    }
+    return result;
+}
+}
+
+// ---------------- Allocation tracking --------------------------
+bool IsAllocationTrackingCompiled(){
+#ifdef TC_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CountAllocation(size_t bytes){
+    if(current_allocations != nullptr){
+        ++current_allocations->count;
+        current_allocations->bytes += bytes;
+    }
+}
+
+AllocationCounter* CurrentAllocations(){
+    return current_allocations;
+}
+
+AllocationScope::AllocationScope(AllocationCounter* counter) : previous_(current_allocations){
+    current_allocations = counter;
+}
+
+AllocationScope::~AllocationScope(){
+    current_allocations = previous_;
+}
+
+// ---------------- LatencyHistogram --------------------------
+size_t LatencyHistogram::BucketIndex(uint64_t value){
+    if(value < LINEAR_LIMIT){
+        return value;
+    }
+    // Top 5 bits of the value pick one of 16 buckets within its power of two
+    int shift = HighestBit(value) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKET_COUNT + (value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index){
+    if(index < LINEAR_LIMIT){
+        return index;
+    }
+    int shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t top_bits = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((top_bits + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds){
+    ++buckets_[BucketIndex(nanoseconds)];
+    ++count_;
+    total_ += nanoseconds;
+    max_ = std::max(max_, nanoseconds);
+}
+
+uint64_t LatencyHistogram::Count() const{
+    return count_;
+}
+
+uint64_t LatencyHistogram::Total() const{
+    return total_;
+}
+
+uint64_t LatencyHistogram::Max() const{
+    return max_;
+}
+
+uint64_t LatencyHistogram::Percentile(double share) const{
+    if(count_ == 0){
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(share * count_ + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for(size_t i = 0; i < BUCKET_COUNT; ++i){
+        seen += buckets_[i];
+        if(seen >= rank){
+            return std::min(BucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+// ---------------- Registry --------------------------
+Registry& Registry::Instance(){
+    static Registry registry;
+    return registry;
+}
+
+void Registry::Enable(){
+    enabled_ = true;
+}
+
+bool Registry::IsEnabled() const{
+    return enabled_;
+}
+
+void Registry::EnableMemory(){
+    memory_enabled_ = true;
+}
+
+bool Registry::IsMemoryEnabled() const{
+    return memory_enabled_;
+}
+
+void Registry::RecordMemory(const std::string& prefix, const memory::Report& report){
+    for(const auto& [name, bytes] : report){
+        RecordMemory(prefix + "." + name, bytes);
+    }
+}
+
+void Registry::RecordMemory(const std::string& name, size_t bytes){
+    std::lock_guard<std::mutex> guard(mutex_);
+    size_t& recorded = memory_[name];
+    recorded = std::max(recorded, bytes);
+}
+
+void Registry::Record(MetricKind kind, std::string_view name, uint64_t nanoseconds,
+                      const AllocationCounter& allocations){
+    auto& metrics = kind == MetricKind::PHASE ? phases_ : requests_;
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = metrics.find(name);
+    if(it == metrics.end()){
+        it = metrics.emplace(std::string(name), Metric{}).first;
+    }
+    it->second.latency.Record(nanoseconds);
+    it->second.allocations.count += allocations.count;
+    it->second.allocations.bytes += allocations.bytes;
+}
+
+json::Node Registry::Report() const{
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    json::Dict phases;
+    for(const auto& [name, metric] : phases_){
+        phases.emplace(name, MetricToJson(metric, MetricKind::PHASE));
+    }
+    json::Dict requests;
+    for(const auto& [name, metric] : requests_){
+        requests.emplace(name, MetricToJson(metric, MetricKind::REQUEST));
+    }
+
+    json::Dict report{
+        {"phases", std::move(phases)},
+        {"requests", std::move(requests)}
+    };
+
+    if(!memory_.empty()){
+        json::Dict memory;
+        size_t total = 0;
+        for(const auto& [name, bytes] : memory_){
+            memory.emplace(name, CounterToJson(bytes));
+            total += bytes;
+        }
+        memory.emplace("total", CounterToJson(total));
+        report.emplace("memory_bytes", std::move(memory));
+    }
+    return report;
+}
+
+// ---------------- ScopedTimer --------------------------
+ScopedTimer::ScopedTimer(MetricKind kind, std::string_view name)
+    : kind_(kind), name_(name), enabled_(Registry::Instance().IsEnabled()){
+    if(enabled_){
+        parent_allocations_ = current_allocations;
+        current_allocations = &allocations_;
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedTimer::~ScopedTimer(){
+    if(!enabled_){
+        return;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+
+    current_allocations = parent_allocations_;
+    if(parent_allocations_ != nullptr){
+        parent_allocations_->count += allocations_.count;
+        parent_allocations_->bytes += allocations_.bytes;
+    }
+
+    Registry::Instance().Record(kind_, name_,
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                allocations_);
+}
+
+void PrintReport(const std::string& path){
+    json::Document report{Registry::Instance().Report()};
+
+    if(path.empty()){
+        json::Print(report, std::cerr);
+        std::cerr << std::endl;
+    }else{
+        std::ofstream output(path);
+        json::Print(report, output);
+        output << std::endl;
+    }
+}
+}
+
+#ifdef TC_TRACK_ALLOCATIONS
+// ---------------- Global allocation hook --------------------------
+// GCC sees free() pairing with operator new once the hook is inlined into this file
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size){
+    stats::CountAllocation(size);
+    if(void* pointer = std::malloc(size == 0 ? 1 : size)){
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept{
+    std::free(pointer);
+}
+#endif
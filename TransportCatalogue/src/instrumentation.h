@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "../src/json.h"
+#include "../src/memory_usage.h"
+
+namespace stats{
+
+enum class MetricKind{
+    PHASE,   // pipeline stage: input parse, catalogue update, printing
+    REQUEST  // single stat request, grouped by its type
+};
+
+// HDR-style histogram: values below 32 have their own bucket, larger ones
+// fall into 16 buckets per power of two, which keeps relative error under ~6%
+class LatencyHistogram{
+public:
+    void Record(uint64_t nanoseconds);
+
+    uint64_t Count() const;
+    uint64_t Total() const;
+    uint64_t Max() const;
+    uint64_t Percentile(double share) const;
+
+private:
+    static const size_t BUCKET_COUNT = 976;
+
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(size_t index);
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> buckets_ = {};
+    uint64_t count_ = 0;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+struct AllocationCounter{
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+// Builds with TC_TRACK_ALLOCATIONS replace global operator new, every allocation
+// is then added to the innermost running ScopedTimer of the thread
+bool IsAllocationTrackingCompiled();
+void CountAllocation(size_t bytes);
+
+// Counter allocations of the calling thread go to, nullptr outside of any timer
+AllocationCounter* CurrentAllocations();
+
+// Points the allocations of the calling thread at counter until the end of the scope.
+// Worker threads use it to count into a counter the starting thread merges afterwards
+class AllocationScope{
+public:
+    explicit AllocationScope(AllocationCounter* counter);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    AllocationCounter* previous_;
+};
+
+struct Metric{
+    LatencyHistogram latency;
+    AllocationCounter allocations;
+};
+
+// Process wide collection of timings. Disabled unless Enable() is called,
+// timers then cost a single flag check.
+class Registry{
+public:
+    static Registry& Instance();
+
+    void Enable();
+    bool IsEnabled() const;
+
+    // Memory accounting walks whole structures, so it is switched on separately
+    void EnableMemory();
+    bool IsMemoryEnabled() const;
+
+    void Record(MetricKind kind, std::string_view name, uint64_t nanoseconds,
+                const AllocationCounter& allocations);
+
+    // Keeps the largest size seen for every structure, prefix groups the report
+    void RecordMemory(const std::string& prefix, const memory::Report& report);
+    void RecordMemory(const std::string& name, size_t bytes);
+
+    json::Node Report() const;
+
+private:
+    bool enabled_ = false;
+    bool memory_enabled_ = false;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Metric, std::less<>> phases_;
+    std::map<std::string, Metric, std::less<>> requests_;
+    memory::Report memory_;
+};
+
+class ScopedTimer{
+public:
+    ScopedTimer(MetricKind kind, std::string_view name);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    MetricKind kind_;
+    std::string_view name_;
+    bool enabled_;
+    std::chrono::steady_clock::time_point start_;
+
+    // Allocations made inside the timer scope, nested scopes included
+    AllocationCounter allocations_;
+    AllocationCounter* parent_allocations_ = nullptr;
+};
+
+// Writes Registry report, to stderr when path is empty
+void PrintReport(const std::string& path);
+}
@@ -1,4 +1,5 @@
 #include "../src/json.h"
+#include "../src/memory_usage.h"
 
 using namespace std;
 
@@ -220,6 +221,124 @@ Document Load(istream& input) {
     return Document{LoadNode(input)};
 }
 
+namespace {
+
+// Read-only stream buffer over text that is already in memory
+class ViewBuffer : public std::streambuf {
+public:
+    explicit ViewBuffer(std::string_view text) {
+        char* begin = const_cast<char*>(text.data());
+        setg(begin, begin, begin + text.size());
+    }
+};
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && IsSpace(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && IsSpace(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Position after the closing quote of the string opened at position
+size_t SkipString(std::string_view text, size_t position) {
+    for (++position; position < text.size(); ++position) {
+        if (text[position] == '\\') {
+            ++position;
+        } else if (text[position] == '"') {
+            return position + 1;
+        }
+    }
+    throw ParsingError("String parsing error");
+}
+
+}  // namespace
+
+Document Load(std::string_view input) {
+    ViewBuffer buffer(input);
+    std::istream stream(&buffer);
+    return Load(stream);
+}
+
+std::optional<ArrayElements> SplitTopLevelArray(std::string_view document, std::string_view key) {
+    int depth = 0;
+    bool expect_key = false;
+    std::string_view last_key;
+    std::optional<size_t> array_begin;
+
+    // Find the array start: '[' right after the key at the top level
+    for (size_t position = 0; position < document.size() && !array_begin;) {
+        const char c = document[position];
+
+        if (c == '"') {
+            size_t end = SkipString(document, position);
+            if (depth == 1 && expect_key) {
+                last_key = document.substr(position + 1, end - position - 2);
+                expect_key = false;
+            }
+            position = end;
+            continue;
+        }
+
+        if (c == '[' && depth == 1 && last_key == key) {
+            array_begin = position;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+            expect_key = depth == 1 && c == '{';
+        } else if (c == '}' || c == ']') {
+            --depth;
+        } else if (c == ',' && depth == 1) {
+            expect_key = true;
+            last_key = {};
+        }
+        ++position;
+    }
+
+    if (!array_begin) {
+        return std::nullopt;
+    }
+
+    // Split the array on commas of its own level
+    ArrayElements result;
+    result.begin = *array_begin;
+    depth = 0;
+    size_t element_begin = result.begin + 1;
+
+    for (size_t position = result.begin + 1; position < document.size();) {
+        const char c = document[position];
+
+        if (c == '"') {
+            position = SkipString(document, position);
+            continue;
+        }
+
+        if (c == '{' || c == '[') {
+            ++depth;
+        } else if ((c == '}' || c == ']') && depth > 0) {
+            --depth;
+        } else if ((c == ',' || c == ']') && depth == 0) {
+            std::string_view element = Trim(document.substr(element_begin, position - element_begin));
+            if (!element.empty()) {
+                result.elements.push_back(element);
+            }
+            element_begin = position + 1;
+
+            if (c == ']') {
+                result.end = position + 1;
+                return result;
+            }
+        }
+        ++position;
+    }
+    throw ParsingError("Incorrect array input"s);
+}
+
 // ----------------- Print -------------------------
 
 void PrintString(const Node& node, std::ostream& output){
@@ -306,4 +425,26 @@ void Print(const Document& doc, std::ostream& output) {
     }
 
 }
+// ----------------- Memory usage -------------------------
+
+size_t HeapUsage(const Node& node){
+    if (node.IsString()) {
+        return memory::HeapUsage(node.AsString());
+    }
+
+    size_t result = 0;
+    if (node.IsArray()) {
+        result += memory::HeapUsage(node.AsArray());
+        for (const auto& child : node.AsArray()) {
+            result += HeapUsage(child);
+        }
+    }
+    if (node.IsDict()) {
+        result += memory::HeapUsage(node.AsDict());
+        for (const auto& [key, child] : node.AsDict()) {
+            result += memory::HeapUsage(key) + HeapUsage(child);
+        }
+    }
+    return result;
+}
 }  // namespace json
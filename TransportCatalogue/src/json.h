@@ -3,7 +3,9 @@
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -134,6 +136,9 @@ public:
     const Value& GetValue() const {
         return *this;
     }
+    Value& GetValue() {
+        return *this;
+    }
 };
 
 inline bool operator!=(const Node& lhs, const Node& rhs) {
@@ -163,7 +168,22 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
 }
 
 Document Load(std::istream& input);
+Document Load(std::string_view input);
+
+// Raw texts of the elements of an array, found by a structural pre-scan
+// that only tracks strings and nesting without building any nodes
+struct ArrayElements {
+    size_t begin = 0; // position of '['
+    size_t end = 0;   // position after ']'
+    std::vector<std::string_view> elements;
+};
+
+// Looks for key in the top level dictionary of document, the value must be an array
+std::optional<ArrayElements> SplitTopLevelArray(std::string_view document, std::string_view key);
 
 void Print(const Document& doc, std::ostream& output);
 
+// Heap bytes held by the node and all of its children
+size_t HeapUsage(const Node& node);
+
 }  // namespace json
@@ -3,116 +3,150 @@
 namespace json{
 using namespace json;
 
-Builder& Builder::Value(Node::Value value){
-    CheckFunctionSequenceCall();
-    last_operation_ = JsonBuilderOperations::VALUE;
+Builder::Builder(std::ostream& output)
+    : output_(&output) {
+}
 
-    if(std::holds_alternative<Array>(value) || std::holds_alternative<Dict>(value)){
-        nodes_stack_.push_back(new Node(value));
+Builder& Builder::Value(Node::Value value){
+    BeginValue();
+    if(output_){
+        Print(Document(Node(std::move(value))), *output_);
+        EndValue(nullptr);
     }else{
-        if(!nodes_stack_.empty() && (nodes_stack_.back()->IsArray() || nodes_stack_.back()->IsDict())){
-            StartChild(nodes_stack_.back(), value);
-        }else{
-            nodes_stack_.push_back(new Node(value));
-        }
+        EndValue(std::move(value));
+    }
+    return *this;
+}
+
+Builder& Builder::RawValue(std::string_view text){
+    if(!output_){
+        throw std::logic_error("Raw values can only be streamed!");
     }
+    BeginValue();
+    output_->write(text.data(), text.size());
+    EndValue(nullptr);
     return *this;
 }
 
 DictValueContext Builder::Key(std::string key){
-    if(!nodes_stack_.back()->IsDict() || last_operation_ == JsonBuilderOperations::KEY){
+    if(open_containers_.empty() || !open_containers_.back().is_dict || key_){
         throw std::logic_error("Key function called outside Dictionary or after another Key()!");
     }
 
-    last_operation_ = JsonBuilderOperations::KEY;
-    keys_.push_back(std::move(key));
-
+    if(output_){
+        StreamSeparator();
+        *output_ << '"' << key << "\": ";
+    }
+    key_ = std::move(key);
     return DictValueContext(*this);
 }
 
 ArrayItemContext Builder::StartArray(){
-    CheckFunctionSequenceCall();
-    last_operation_ = JsonBuilderOperations::START_ARRAY;
-
-    nodes_stack_.push_back(new Node(Array{}));
+    StartContainer(Array{});
     return ArrayItemContext(*this);
 }
 
 Builder& Builder::EndArray(){
-    if(!nodes_stack_.back()->IsArray()){
-        throw std::logic_error("Wrong container ending! Must be Dict!");
-    }
-    last_operation_ = JsonBuilderOperations::END_ARRAY;
-
-    Node* array_node = nodes_stack_.back();
-    nodes_stack_.pop_back();
-
-    // If there is a container before this one
-    if(!nodes_stack_.empty() && nodes_stack_.back()->IsArray()){
-        Array* last_node = const_cast<Array*>(&nodes_stack_.back()->AsArray());
-        last_node->push_back(std::move(*array_node));
-    }else if(!nodes_stack_.empty() && nodes_stack_.back()->IsDict()){
-        Dict* last_node = const_cast<Dict*>(&nodes_stack_.back()->AsDict());
-        last_node->emplace(keys_.back(), *array_node);
-        keys_.pop_back();
-    }else{
-        root_ = std::move(*array_node);
-    }
+    EndContainer(false);
     return *this;
 }
 
 DictItemContext Builder::StartDict(){
-    CheckFunctionSequenceCall();
-    last_operation_ = JsonBuilderOperations::START_DICT;
-
-    nodes_stack_.push_back(new Node(Dict{}));
+    StartContainer(Dict{});
     return DictItemContext(*this);
 }
 
 Builder& Builder::EndDict(){
-    if(!nodes_stack_.back()->IsDict()){
-        throw std::logic_error("Wrong container ending! Must be Array!");
+    EndContainer(true);
+    return *this;
+}
+
+json::Node Builder::Build(){
+    if(!complete_ || !open_containers_.empty()){
+        throw std::logic_error("Object not complete!");
     }
-    last_operation_ = JsonBuilderOperations::END_DICT;
-
-    Node* dict_node = nodes_stack_.back();
-    nodes_stack_.pop_back();
-
-    if(!nodes_stack_.empty() && nodes_stack_.back()->IsArray()){
-        Array* last_node = const_cast<Array*>(&nodes_stack_.back()->AsArray());
-        last_node->push_back(std::move(*dict_node));
-    }else if(!nodes_stack_.empty() && nodes_stack_.back()->IsDict()){
-        Dict* last_node = const_cast<Dict*>(&nodes_stack_.back()->AsDict());
-        last_node->emplace(keys_.back(), *dict_node);
-        keys_.pop_back();
+    complete_ = false;
+    if(!root_){
+        return {};
+    }
+    Node result = std::move(*root_);
+    root_.reset();
+    return result;
+}
+
+void Builder::BeginValue(){
+    if(complete_){
+        throw std::logic_error("Value node is being created outside the container!");
+    }
+    if(!open_containers_.empty() && open_containers_.back().is_dict && !key_){
+        throw std::logic_error("Key must be set 1st before value in dictionary!");
+    }
+
+    // Dict values follow their key, which is printed with the separator
+    if(output_ && !open_containers_.empty() && !open_containers_.back().is_dict){
+        StreamSeparator();
+    }
+}
+
+Node* Builder::EndValue(Node::Value value){
+    Node* node = nullptr;
+    if(open_containers_.empty()){
+        complete_ = true;
+        if(!output_){
+            root_ = std::make_unique<Node>(std::move(value));
+            node = root_.get();
+        }
     }else{
-        root_ = std::move(*dict_node);
+        OpenContainer& container = open_containers_.back();
+        container.empty = false;
+        if(container.is_dict){
+            if(container.node){
+                Dict& dict = std::get<Dict>(container.node->GetValue());
+                node = &dict.emplace(std::move(*key_), Node(std::move(value))).first->second;
+            }
+            key_.reset();
+        }else if(container.node){
+            Array& array = std::get<Array>(container.node->GetValue());
+            node = &array.emplace_back(Node(std::move(value)));
+        }
     }
-    return *this;
+    return node;
 }
 
-json::Node Builder::Build(){
-    if(nodes_stack_.size() == 1){
-        root_ = std::move(*nodes_stack_.back());
-        nodes_stack_.pop_back();
+void Builder::StartContainer(Node::Value container){
+    const bool is_dict = std::holds_alternative<Dict>(container);
+    BeginValue();
+    if(output_){
+        *output_ << (is_dict ? "{\n" : "[\n  ");
     }
-    if(!nodes_stack_.empty() || last_operation_ == JsonBuilderOperations::CONSTRUCTOR){
-        throw std::logic_error("Object not complete!");
+    Node* node = EndValue(std::move(container));
+    // The document is complete only when its root container ends
+    complete_ = false;
+    open_containers_.push_back({node, is_dict, true});
+}
+
+void Builder::EndContainer(bool is_dict){
+    if(open_containers_.empty() || open_containers_.back().is_dict != is_dict){
+        throw std::logic_error(is_dict ? "Wrong container ending! Must be Array!" : "Wrong container ending! Must be Dict!");
+    }
+    if(key_){
+        throw std::logic_error("Dictionary ended before the value of its last key!");
     }
-    return root_;
+
+    if(output_){
+        *output_ << (is_dict ? "\n}" : "\n]");
+    }
+    open_containers_.pop_back();
+    complete_ = open_containers_.empty();
 }
 
-void Builder::CheckFunctionSequenceCall(){
-     if(last_operation_ == JsonBuilderOperations::START_DICT){
-         throw std::logic_error("Function must be called after constructor, Key() or container element!");
-     }
-     if((last_operation_ == JsonBuilderOperations::END_DICT ||
-             last_operation_ == JsonBuilderOperations::END_ARRAY) && nodes_stack_.empty()){
-         throw std::logic_error("Value node is being created outside the container!");
-     }
-     if(!nodes_stack_.empty() && nodes_stack_.back()->IsDict() && last_operation_ != JsonBuilderOperations::KEY){
-          throw std::logic_error("Key must be set 1st before value in dictionary!");
-     }
+void Builder::StreamSeparator(){
+    OpenContainer& container = open_containers_.back();
+    if(!container.empty){
+        *output_ << (container.is_dict ? ",\n  " : ", ");
+    }else if(container.is_dict){
+        *output_ << "  ";
+    }
 }
 
 }
@@ -2,31 +2,41 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 #include "../src/json.h"
 
 namespace json{
 using namespace json;
 
-enum class JsonBuilderOperations{
-    CONSTRUCTOR,
-    KEY,
-    VALUE,
-    START_ARRAY,
-    END_ARRAY,
-    START_DICT,
-    END_DICT
-};
-
 class Builder;
 class ArrayItemContext;
 class DictItemContext;
 class DictValueContext;
 
+// Builds a document in place: values are moved into their containers and every open container
+// is reached through a pointer into the tree, nothing is copied on the way. The contexts returned
+// by Key, StartDict and StartArray only refer to the builder and allow the calls valid at that point.
+// Constructed with a stream the builder prints the document while it is built, in the json::Print
+// format, without making any nodes. Dict keys are then printed in call order, not sorted.
 class Builder{
 public:
+    Builder() = default;
+    explicit Builder(std::ostream& output);
+
+    Builder(const Builder&) = delete;
+    Builder& operator=(const Builder&) = delete;
+    Builder(Builder&&) = default;
+    Builder& operator=(Builder&&) = default;
+
     Builder& Value(Node::Value value);
+    // Already formatted JSON text, streaming mode only
+    Builder& RawValue(std::string_view text);
     DictValueContext Key(std::string key);
 
     DictItemContext StartDict();
@@ -35,67 +45,101 @@ public:
     ArrayItemContext StartArray();
     Builder& EndArray();
 
+    // Moves the finished document out. In streaming mode checks that the document is complete
+    // and returns null
     json::Node Build();
 
 private:
-    template <typename Container>
-    void StartChild(Container* container, Node::Value& value){
-        if(container->IsArray()){
-            Array* array_node = const_cast<Array*>(&container->AsArray());
-            array_node->push_back(std::move(Node(value)));
-        }else if(container->IsDict()){
-            Dict* dict_node = const_cast<Dict*>(&container->AsDict());
-            dict_node->emplace(keys_.back(), Node(value));
-            keys_.pop_back();
-        }
-    }
-
-    void CheckFunctionSequenceCall();
+    // Checks that a value may come next and prints the separator before it when streaming
+    void BeginValue();
+    // Puts a value where the next one goes, returns the node it became or nullptr when streaming
+    Node* EndValue(Node::Value value);
+    void StartContainer(Node::Value container);
+    void EndContainer(bool is_dict);
+    // Separator before the next element of the innermost streamed container
+    void StreamSeparator();
 
 private:
-    json::Node root_;
-    std::vector<Node*> nodes_stack_;
-
-    std::vector<std::string> keys_;
-    JsonBuilderOperations last_operation_ = JsonBuilderOperations::CONSTRUCTOR;
+    struct OpenContainer{
+        Node* node = nullptr; // stays nullptr in streaming mode
+        bool is_dict = false;
+        bool empty = true;
+    };
+
+    std::unique_ptr<json::Node> root_; // on the heap, open container pointers survive a move of the builder
+    bool complete_ = false;
+    std::vector<OpenContainer> open_containers_;
+    std::optional<std::string> key_; // waits for its value
+
+    std::ostream* output_ = nullptr;
 };
 
-class ArrayItemContext : public Builder {
+class ArrayItemContext{
 public:
-    ArrayItemContext(Builder base) : Builder(base) {}
+    explicit ArrayItemContext(Builder& builder) : builder_(builder) {}
 
-    ArrayItemContext Value(Node::Value value) {
-        return Builder::Value(std::move(value));
-    }
+    ArrayItemContext Value(Node::Value value);
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
+    Builder& EndArray();
 
-    Node Build() = delete;
-    DictValueContext Key(std::string key) = delete;
-    Builder EndDict() = delete;
+private:
+    Builder& builder_;
 };
 
-class DictItemContext : public Builder {
+class DictItemContext{
 public:
-    DictItemContext(Builder base) : Builder(base) {}
+    explicit DictItemContext(Builder& builder) : builder_(builder) {}
 
-    Builder& Value(Node::Value value) = delete;
-    DictItemContext StartDict() = delete;
-    ArrayItemContext StartArray() = delete;
-    Builder& EndArray() = delete;
-    json::Node Build() = delete;
+    DictValueContext Key(std::string key);
+    Builder& EndDict();
+
+private:
+    Builder& builder_;
 };
 
-class DictValueContext : public Builder {
+class DictValueContext{
 public:
-    DictValueContext(Builder base) : Builder(base) {}
+    explicit DictValueContext(Builder& builder) : builder_(builder) {}
 
-    DictItemContext Value(Node::Value value){
-        return Builder::Value(value);
-    }
+    DictItemContext Value(Node::Value value);
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
 
-    DictValueContext Key(std::string key) = delete;
-    Builder& EndDict() = delete;
-    Builder& EndArray() = delete;
-    json::Node Build() = delete;
+private:
+    Builder& builder_;
 };
 
+inline ArrayItemContext ArrayItemContext::Value(Node::Value value){
+    builder_.Value(std::move(value));
+    return *this;
+}
+inline DictItemContext ArrayItemContext::StartDict(){
+    return builder_.StartDict();
+}
+inline ArrayItemContext ArrayItemContext::StartArray(){
+    return builder_.StartArray();
+}
+inline Builder& ArrayItemContext::EndArray(){
+    return builder_.EndArray();
+}
+
+inline DictValueContext DictItemContext::Key(std::string key){
+    return builder_.Key(std::move(key));
+}
+inline Builder& DictItemContext::EndDict(){
+    return builder_.EndDict();
+}
+
+inline DictItemContext DictValueContext::Value(Node::Value value){
+    builder_.Value(std::move(value));
+    return DictItemContext(builder_);
+}
+inline DictItemContext DictValueContext::StartDict(){
+    return builder_.StartDict();
+}
+inline ArrayItemContext DictValueContext::StartArray(){
+    return builder_.StartArray();
+}
+
 }
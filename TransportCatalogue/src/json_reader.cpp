@@ -1,51 +1,280 @@
 #include "../src/json_reader.h"
 
+JsonReader::JsonReader(std::ostream& output)
+    : output_(&output) {
+}
+
+void JsonReader::SetIndexThreadCount(unsigned thread_count){
+    index_threads_ = std::max(1u, thread_count);
+}
+
+void JsonReader::SetStreamAnswers(bool stream_answers){
+    stream_answers_ = stream_answers;
+}
+
+void JsonReader::SetPrecomputeAnswers(bool precompute_answers){
+    precompute_answers_ = precompute_answers;
+}
+
 void JsonReader::ExecuteJsonQuery(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue){
     ReadNode(node, catalogue);
 }
 
+void JsonReader::ExecuteJsonQuery(std::string_view document, transport_catalogue::TransportCatalogue& catalogue,
+                                  unsigned thread_count){
+    std::optional<json::ArrayElements> base_requests = json::SplitTopLevelArray(document, "base_requests");
+    if(!base_requests){
+        std::optional<json::Document> root;
+        {
+            stats::ScopedTimer timer(stats::MetricKind::PHASE, "json_load");
+            root = json::Load(document);
+        }
+        ReadNode(root->GetRoot(), catalogue);
+        return;
+    }
+
+    {
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "base_requests_parallel");
+        ReadBaseRequestsParallel(base_requests->elements, thread_count);
+    }
+
+    // The rest of the document goes through the usual path, base requests left empty
+    std::string rest;
+    rest.reserve(document.size() - (base_requests->end - base_requests->begin) + 2);
+    rest.append(document.substr(0, base_requests->begin));
+    rest.append("[]");
+    rest.append(document.substr(base_requests->end));
+
+    std::optional<json::Document> root;
+    {
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "json_load");
+        root = json::Load(rest);
+    }
+    ReadNode(root->GetRoot(), catalogue);
+}
+
 void JsonReader::ReadNode(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue) {
     for(const auto& request : node.AsDict()){
         if(request.first == "base_requests"){
-            CheckBaseRequests(request.second);
-            UpdateTransportCatalogue(catalogue);
+            ReadBaseRequests(request.second, catalogue);
         }
         else if(request.first == "render_settings"){
-            renderer_data_.SetRenderSettings(request.second.AsDict());
+            ReadRenderSettings(request.second);
         }else if(request.first == "stat_requests"){
-            CheckStatRequests(request.second, catalogue);
-            PrintData();
+            if(stream_answers_){
+                StreamStatRequests(request.second, catalogue, *output_);
+                continue;
+            }
+            ReadStatRequests(request.second, catalogue);
+            PrintData(*output_);
         }
     }
 }
 
+void JsonReader::ReadBaseRequests(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue){
+    {
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "base_requests");
+        CheckBaseRequests(node);
+    }
+    {
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "catalogue_update");
+        UpdateTransportCatalogue(catalogue);
+    }
+    {
+        // Only queries follow, switch to the read-optimized layout
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "freeze");
+        catalogue.Freeze(index_threads_);
+    }
+    if(precompute_answers_){
+        stats::ScopedTimer timer(stats::MetricKind::PHASE, "answer_cache");
+        BuildAnswerCache(catalogue);
+    }
+}
+
+void JsonReader::ReadRenderSettings(const json::Node& node){
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "render_settings");
+    renderer_data_.SetRenderSettings(node.AsDict());
+}
+
+void JsonReader::ReadStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue){
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "stat_requests");
+    CheckStatRequests(node, catalogue);
+}
+
 // ---------------- STAT REQUESTS --------------------------
-void JsonReader::CheckStatRequests(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue){
+void JsonReader::CheckStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue){
     output_json_.reserve(node.AsArray().size());
 
     for(const auto& request : node.AsArray()){
-        if(request.AsDict().at("type").AsString() == "Bus"){
-            GetBusRouteJson(request, catalogue);
-        }else if(request.AsDict().at("type").AsString() == "Stop"){
-            GetStopJson(request, catalogue);
+        stats::ScopedTimer timer(stats::MetricKind::REQUEST, request.AsDict().at("type").AsString());
+        AnswerStatRequest(request, catalogue);
+    }
+}
+
+void JsonReader::StreamStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue,
+                                    std::ostream& output){
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "stat_requests");
+    // Same text as PrintData, one answer at a time
+    json::Builder writer(output);
+    writer.StartArray();
+    for(const auto& request : node.AsArray()){
+        stats::ScopedTimer timer(stats::MetricKind::REQUEST, request.AsDict().at("type").AsString());
+        if(AnswerFromCache(request, catalogue, writer)){
+            continue;
+        }
+
+        AnswerStatRequest(request, catalogue);
+        if(!output_json_.empty()){
+            writer.Value(std::move(output_json_.back().GetValue()));
+            output_json_.clear();
         }
-        else if(request.AsDict().at("type").AsString() == "Map"){
-            std::vector<entities::BusRouteRenderInfo> bus_routes = catalogue.GetRenderData();
-            renderer_data_.AddRenderData(bus_routes);
+    }
+    writer.EndArray();
+    writer.Build();
+}
+
+void JsonReader::AnswerStatRequest(const json::Node& request, const transport_catalogue::TransportCatalogue& catalogue){
+    if(request.AsDict().at("type").AsString() == "Bus"){
+        GetBusRouteJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "Stop"){
+        GetStopJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "NearestStops"){
+        GetNearestStopsJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "BoundingBox"){
+        GetBoundingBoxJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "Autocomplete"){
+        GetAutocompleteJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "BusSegment"){
+        GetBusSegmentJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "CommonBuses"){
+        GetCommonBusesJson(request, catalogue);
+    }else if(request.AsDict().at("type").AsString() == "Transfers"){
+        GetTransfersJson(request, catalogue);
+    }
+    else if(request.AsDict().at("type").AsString() == "Map"){
+        GetMapJson(request, catalogue);
+    }
+}
+
+void JsonReader::BuildAnswerCache(const transport_catalogue::TransportCatalogue& catalogue){
+    const std::deque<entities::Bus>& buses = catalogue.GetBuses();
+    std::vector<std::string_view> bus_names;
+    bus_names.reserve(buses.size());
+    for(const auto& bus : buses){
+        bus_names.push_back(bus.name);
+    }
+    bus_answers_.Build(bus_names, index_threads_, [&](size_t index){
+        std::ostringstream answer;
+        json::Print(json::Document{ConvertBusRouteInfoToJson(catalogue.RouteInformation(buses[index].name), 0)}, answer);
+        return answer.str();
+    });
+
+    const std::deque<entities::Stop>& stops = catalogue.GetStops();
+    std::vector<std::string_view> stop_names;
+    stop_names.reserve(stops.size());
+    for(const auto& stop : stops){
+        stop_names.push_back(stop.name);
+    }
+    stop_answers_.Build(stop_names, index_threads_, [&](size_t index){
+        std::ostringstream answer;
+        json::Print(json::Document{ConvertStopInfoToJson(catalogue.StopInformation(stops[index].name), 0)}, answer);
+        return answer.str();
+    });
+
+    cached_catalogue_ = &catalogue;
+    cached_version_ = catalogue.GetVersion();
+
+    if(stats::Registry::Instance().IsMemoryEnabled()){
+        stats::Registry::Instance().RecordMemory("answer_cache", bus_answers_.HeapUsage() + stop_answers_.HeapUsage());
+    }
+}
+
+bool JsonReader::AnswerFromCache(const json::Node& request, const transport_catalogue::TransportCatalogue& catalogue,
+                                 json::Builder& writer){
+    if(cached_catalogue_ != &catalogue || cached_version_ != catalogue.GetVersion()){
+        return false;
+    }
+
+    const json::Dict& fields = request.AsDict();
+    const std::string& type = fields.at("type").AsString();
+    const answers::AnswerCache* cache = nullptr;
+    if(type == "Bus"){
+        cache = &bus_answers_;
+    }else if(type == "Stop"){
+        cache = &stop_answers_;
+    }else{
+        return false;
+    }
+
+    answer_text_.clear();
+    if(!cache->Append(fields.at("name").AsString(), fields.at("id").AsInt(), answer_text_)){
+        return false;
+    }
+    writer.RawValue(answer_text_);
+    return true;
+}
 
-            // Put all svg render data into Json
-            std::stringstream map_string;
-            renderer_data_.RenderObjects(map_string);
+void JsonReader::GetMapJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "map_render");
+    const json::Dict& request = node.AsDict();
+    int request_id = request.at("id").AsInt();
 
+    // Tile z/x/y
+    if(request.find("zoom") != request.end()){
+        map::TileAddress tile = {request.at("zoom").AsInt(), request.at("x").AsInt(), request.at("y").AsInt()};
+        if(tile.zoom < 0 || tile.zoom > map::MAX_TILE_ZOOM || tile.x < 0 || tile.y < 0
+           || tile.x >= (1 << tile.zoom) || tile.y >= (1 << tile.zoom)){
             output_json_.push_back(json::Dict{
-                {"map", map_string.str()},
-                {"request_id", request.AsDict().at("id").AsInt()}
+                {"request_id", request_id},
+                {"error_message", "not found"}
             });
+            return;
         }
+
+        if(const std::string* cached_map = renderer_data_.FindCachedTile(tile, catalogue.GetVersion())){
+            output_json_.push_back(ConvertMapToJson(*cached_map, request_id));
+            return;
+        }
+
+        spatial::BoundingBox box = renderer_data_.SetTileProjector(catalogue.GetRouteBounds(), tile);
+        renderer_data_.AddTileRenderData(catalogue.GetRenderData(box), catalogue.GetStopCoordinates(), box);
+
+        std::stringstream map_string;
+        renderer_data_.RenderObjects(map_string);
+        renderer_data_.CacheTile(tile, catalogue.GetVersion(), map_string.str());
+
+        output_json_.push_back(ConvertMapToJson(map_string.str(), request_id));
+        return;
+    }
+
+    // Bounding box
+    if(request.find("min_latitude") != request.end()){
+        spatial::BoundingBox box = ReadBoundingBox(request);
+        renderer_data_.AddViewportRenderData(catalogue.GetRenderData(box), catalogue.GetStopCoordinates(), box);
+    }else{
+        renderer_data_.AddRenderData(catalogue.GetRenderData(), catalogue.GetStopCoordinates());
     }
+
+    // Put all svg render data into Json
+    std::stringstream map_string;
+    renderer_data_.RenderObjects(map_string);
+
+    output_json_.push_back(ConvertMapToJson(map_string.str(), request_id));
+}
+
+json::Dict JsonReader::ConvertMapToJson(const std::string& map, int request_id)const{
+    return json::Dict{
+        {"map", map},
+        {"request_id", request_id}
+    };
+}
+
+spatial::BoundingBox JsonReader::ReadBoundingBox(const json::Dict& request)const{
+    return {{request.at("min_latitude").AsDouble(), request.at("min_longitude").AsDouble()},
+            {request.at("max_latitude").AsDouble(), request.at("max_longitude").AsDouble()}};
 }
 
-void JsonReader::GetBusRouteJson(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue) {
+void JsonReader::GetBusRouteJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
     std::string bus_name = node.AsDict().at("name").AsString();
 
     entities::BusRoute route = catalogue.RouteInformation(bus_name);
@@ -71,7 +300,7 @@ json::Dict JsonReader::ConvertBusRouteInfoToJson(const entities::BusRoute& route
     return node;
 }
 
-void JsonReader::GetStopJson(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue) {
+void JsonReader::GetStopJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
     std::string stop_name = node.AsDict().at("name").AsString();
     output_json_.push_back(ConvertStopInfoToJson(catalogue.StopInformation(stop_name), node.AsDict().at("id").AsInt()));
 }
@@ -97,8 +326,201 @@ json::Dict JsonReader::ConvertStopInfoToJson(const entities::StopBusList& stop_i
     }
 }
 
-void JsonReader::PrintData(){
-    json::Print(json::Document{output_json_}, std::cout);
+void JsonReader::GetNearestStopsJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+    geo::Coordinates point = {request.at("latitude").AsDouble(), request.at("longitude").AsDouble()};
+
+    int count = 1;
+    if(request.find("count") != request.end()){
+        count = std::max(request.at("count").AsInt(), 0);
+    }
+
+    output_json_.push_back(ConvertNearestStopsToJson(catalogue.FindNearestStops(point, count), request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertNearestStopsToJson(const std::vector<entities::NearbyStop>& stops, int request_id)const{
+    json::Array stop_list;
+    stop_list.reserve(stops.size());
+
+    for(const auto& [stop, distance] : stops){
+        stop_list.push_back(json::Dict{
+            {"distance", distance},
+            {"name", stop->name}
+        });
+    }
+
+    return json::Dict{
+        {"request_id", request_id},
+        {"stops", stop_list}
+    };
+}
+
+void JsonReader::GetBoundingBoxJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+    spatial::BoundingBox box = ReadBoundingBox(request);
+
+    output_json_.push_back(ConvertAreaInfoToJson(catalogue.AreaInformation(box), request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertAreaInfoToJson(const entities::AreaObjectList& area_info, int request_id)const{
+    json::Array stop_list;
+    stop_list.reserve(area_info.stops.size());
+    for(const auto& name : area_info.stops){
+        stop_list.push_back(json::Node{std::string(name)});
+    }
+
+    json::Array bus_list;
+    bus_list.reserve(area_info.buses.size());
+    for(const auto& name : area_info.buses){
+        bus_list.push_back(json::Node{std::string(name)});
+    }
+
+    return json::Dict{
+        {"buses", bus_list},
+        {"request_id", request_id},
+        {"stops", stop_list}
+    };
+}
+
+void JsonReader::GetAutocompleteJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+
+    int count = 10;
+    if(request.find("count") != request.end()){
+        count = std::max(request.at("count").AsInt(), 0);
+    }
+
+    output_json_.push_back(ConvertSuggestionsToJson(catalogue.FindByPrefix(request.at("prefix").AsString(), count),
+                                                    request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertSuggestionsToJson(const entities::NameSuggestions& suggestions, int request_id)const{
+    json::Array stop_list;
+    stop_list.reserve(suggestions.stops.size());
+    for(const auto& [name, bus_count] : suggestions.stops){
+        stop_list.push_back(json::Dict{
+            {"bus_count", static_cast<int>(bus_count)},
+            {"name", std::string(name)}
+        });
+    }
+
+    json::Array bus_list;
+    bus_list.reserve(suggestions.buses.size());
+    for(const auto& [name, stop_count] : suggestions.buses){
+        bus_list.push_back(json::Dict{
+            {"name", std::string(name)},
+            {"stop_count", static_cast<int>(stop_count)}
+        });
+    }
+
+    return json::Dict{
+        {"buses", bus_list},
+        {"request_id", request_id},
+        {"stops", stop_list}
+    };
+}
+
+void JsonReader::GetBusSegmentJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+    const std::string& bus_name = request.at("name").AsString();
+
+    // Either trip positions or stop names, the first visit of "to" after "from" counts
+    entities::RouteSegment segment;
+    if(request.find("from_position") != request.end()){
+        int from = request.at("from_position").AsInt();
+        int to = request.at("to_position").AsInt();
+        if(from >= 0 && to >= 0){
+            segment = catalogue.SegmentInformation(bus_name, static_cast<size_t>(from), static_cast<size_t>(to));
+        }
+    }else{
+        segment = catalogue.SegmentInformation(bus_name, request.at("from").AsString(), request.at("to").AsString());
+    }
+
+    output_json_.push_back(ConvertSegmentToJson(segment, request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertSegmentToJson(const entities::RouteSegment& segment, int request_id)const{
+    if(!segment.found){
+        return json::Dict{
+            {"request_id", request_id},
+            {"error_message", "not found"}
+        };
+    }
+    return json::Dict{
+        {"request_id", request_id},
+        {"route_length", segment.route_length * 1.0},
+        {"stop_count", segment.stop_count}
+    };
+}
+
+void JsonReader::GetCommonBusesJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+    output_json_.push_back(ConvertCommonBusesToJson(catalogue.CommonBuses(request.at("from").AsString(), request.at("to").AsString()),
+                                                    request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertCommonBusesToJson(const entities::CommonBusList& common, int request_id)const{
+    if(!common.stops_exist){
+        return json::Dict{
+            {"request_id", request_id},
+            {"error_message", "not found"}
+        };
+    }
+
+    json::Array bus_list;
+    bus_list.reserve(common.buses.size());
+    for(const auto& name : common.buses){
+        bus_list.push_back(json::Node{std::string(name)});
+    }
+
+    return json::Dict{
+        {"buses", bus_list},
+        {"request_id", request_id}
+    };
+}
+
+void JsonReader::GetTransfersJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue) {
+    const json::Dict& request = node.AsDict();
+
+    int max_transfers = 1;
+    if(request.find("max_transfers") != request.end()){
+        max_transfers = std::max(request.at("max_transfers").AsInt(), 0);
+    }
+
+    output_json_.push_back(ConvertTransfersToJson(catalogue.ReachableBuses(request.at("name").AsString(), max_transfers),
+                                                  request.at("id").AsInt()));
+}
+
+json::Dict JsonReader::ConvertTransfersToJson(const entities::TransferReach& reach, int request_id)const{
+    if(!reach.stop_exists){
+        return json::Dict{
+            {"request_id", request_id},
+            {"error_message", "not found"}
+        };
+    }
+
+    json::Array bus_list;
+    bus_list.reserve(reach.buses.size());
+    for(const auto& [name, transfers] : reach.buses){
+        bus_list.push_back(json::Dict{
+            {"name", std::string(name)},
+            {"transfers", static_cast<int>(transfers)}
+        });
+    }
+
+    return json::Dict{
+        {"buses", bus_list},
+        {"request_id", request_id}
+    };
+}
+
+void JsonReader::PrintData(std::ostream& output){
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "print");
+    if(stats::Registry::Instance().IsMemoryEnabled()){
+        stats::Registry::Instance().RecordMemory("output_json", json::HeapUsage(output_json_));
+        stats::Registry::Instance().RecordMemory("map_render", renderer_data_.GetMemoryUsage());
+    }
+    json::Print(json::Document{output_json_}, output);
     output_json_.clear(); // Maybe resize to 0
 }
 
@@ -116,24 +538,28 @@ void JsonReader::CheckBaseRequests(const json::Node& node){
 }
 
 void JsonReader::AddBusRouteToInputList(const json::Node& node){
+    input_commands_.push_back(MakeBusRouteCommand(node));
+}
+
+CommandInfo JsonReader::MakeBusRouteCommand(const json::Node& node){
     CommandInfo new_command;
     new_command.command_type = QueryType::NewBusRoute;
     new_command.name = node.AsDict().at("name").AsString();
 
-    new_command.data.reserve(node.AsDict().at("stops").AsArray().size() * 2);
+    new_command.data.reserve(node.AsDict().at("stops").AsArray().size());
     for(const auto& stop : node.AsDict().at("stops").AsArray()){
         new_command.data.push_back(stop.AsString());
     }
 
-    if(!node.AsDict().at("is_roundtrip").AsBool()){
-       new_command.data.insert(new_command.data.end(), new_command.data.rbegin() + 1, new_command.data.rend());
-       new_command.is_roundtrip = false;
-    }
-    input_commands_.push_back(new_command);
+    new_command.is_roundtrip = node.AsDict().at("is_roundtrip").AsBool();
+    return new_command;
 }
 
-
 void JsonReader::AddStopToInputList(const json::Node& node){
+    input_commands_.push_back(MakeStopCommand(node));
+}
+
+CommandInfo JsonReader::MakeStopCommand(const json::Node& node){
     CommandInfo new_command;
 
     new_command.command_type = QueryType::NewStop;
@@ -144,7 +570,35 @@ void JsonReader::AddStopToInputList(const json::Node& node){
     for(const auto& [stop, distance] : node.AsDict().at("road_distances").AsDict()){
         new_command.stop_distance_data.push_back(std::make_pair(stop, distance.AsInt()));
     }
-    input_commands_.push_back(new_command);
+    return new_command;
+}
+
+void JsonReader::ReadBaseRequestsParallel(const std::vector<std::string_view>& requests, unsigned thread_count){
+    thread_count = std::max(1u, std::min<unsigned>(thread_count, requests.size()));
+
+    // Contiguous chunks keep the merged commands in input order
+    std::vector<std::vector<CommandInfo>> chunk_commands(thread_count);
+
+    parallel::RunTasks(thread_count, [&](unsigned chunk){
+        size_t begin = requests.size() * chunk / thread_count;
+        size_t end = requests.size() * (chunk + 1) / thread_count;
+
+        chunk_commands[chunk].reserve(end - begin);
+        for(size_t i = begin; i < end; ++i){
+            json::Document request = json::Load(requests[i]);
+            const std::string& type = request.GetRoot().AsDict().at("type").AsString();
+
+            if(type == "Stop"){
+                chunk_commands[chunk].push_back(MakeStopCommand(request.GetRoot()));
+            }else if(type == "Bus"){
+                chunk_commands[chunk].push_back(MakeBusRouteCommand(request.GetRoot()));
+            }
+        }
+    });
+
+    for(auto& commands : chunk_commands){
+        std::move(commands.begin(), commands.end(), std::back_inserter(input_commands_));
+    }
 }
 
 void JsonReader::UpdateTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue){
@@ -155,6 +609,9 @@ void JsonReader::UpdateTransportCatalogue(transport_catalogue::TransportCatalogu
         JsonReader::LoadSingleCommand(catalogue, command);
     }
     input_commands_.clear();
+
+    stats::ScopedTimer timer(stats::MetricKind::PHASE, "build_indexes");
+    catalogue.BuildIndexes(index_threads_);
 }
 
 void JsonReader::LoadSingleCommand(transport_catalogue::TransportCatalogue& catalogue, const CommandInfo& command)const{
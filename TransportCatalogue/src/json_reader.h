@@ -2,15 +2,25 @@
 
 #include <algorithm>
 #include <deque>
+#include <exception>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <variant>
 
+#include "../src/answer_cache.h"
 #include "../src/domain.h"
 #include "../src/geo.h"
+#include "../src/instrumentation.h"
 #include "../src/json.h"
+#include "../src/json_builder.h"
 #include "../src/map_renderer.h"
+#include "../src/parallel.h"
 #include "../src/svg.h"
 #include "../src/transport_catalogue.h"
 
@@ -32,19 +42,60 @@ struct CommandInfo{
 
 class JsonReader{
 public:
+    JsonReader() = default;
+    // Answers to stat requests are printed to output instead of std::cout
+    explicit JsonReader(std::ostream& output);
+
+    // Threads the catalogue indexes are built on, all hardware threads by default
+    void SetIndexThreadCount(unsigned thread_count);
+    // Prints every answer as soon as it is ready instead of the whole response at the end,
+    // the output is the same
+    void SetStreamAnswers(bool stream_answers);
+    // Prints the answer to every Bus and Stop request once the catalogue is frozen, streamed
+    // answers are then copied from this cache
+    void SetPrecomputeAnswers(bool precompute_answers);
+
     void ExecuteJsonQuery(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
 
+    // Splits base_requests of the raw document by a pre-scan and parses them on several threads
+    void ExecuteJsonQuery(std::string_view document, transport_catalogue::TransportCatalogue& catalogue,
+                          unsigned thread_count);
+
+    // Pipeline stages run by ExecuteJsonQuery, exposed to time them separately
+    void ReadBaseRequests(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
+    void ReadRenderSettings(const json::Node& node);
+    void ReadStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void PrintData(std::ostream& output);
+
 private:
     void ReadNode(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
 
     void CheckBaseRequests(const json::Node& node);
     void AddBusRouteToInputList(const json::Node& node);
     void AddStopToInputList(const json::Node& node);
+    void ReadBaseRequestsParallel(const std::vector<std::string_view>& requests, unsigned thread_count);
 
-    void CheckStatRequests(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
-    void GetBusRouteJson(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
-    void GetStopJson(const json::Node& node, transport_catalogue::TransportCatalogue& catalogue);
-    void PrintData();
+    static CommandInfo MakeBusRouteCommand(const json::Node& node);
+    static CommandInfo MakeStopCommand(const json::Node& node);
+
+    void CheckStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void StreamStatRequests(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue,
+                            std::ostream& output);
+    // Appends the answer to output_json_, unknown request types get none
+    void AnswerStatRequest(const json::Node& request, const transport_catalogue::TransportCatalogue& catalogue);
+    void BuildAnswerCache(const transport_catalogue::TransportCatalogue& catalogue);
+    // Streams a precomputed answer, false when there is none for the request
+    bool AnswerFromCache(const json::Node& request, const transport_catalogue::TransportCatalogue& catalogue,
+                         json::Builder& writer);
+    void GetBusRouteJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetStopJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetNearestStopsJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetBoundingBoxJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetAutocompleteJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetBusSegmentJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetCommonBusesJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetTransfersJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
+    void GetMapJson(const json::Node& node, const transport_catalogue::TransportCatalogue& catalogue);
 
     void UpdateTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue);
     void SetRenderSettings(const json::Dict& node, map::MapRender renderer);
@@ -53,10 +104,30 @@ private:
     void LoadSingleCommand(transport_catalogue::TransportCatalogue& catalogue, const CommandInfo& command)const;
     json::Dict ConvertBusRouteInfoToJson(const entities::BusRoute& route, int request_id)const;
     json::Dict ConvertStopInfoToJson(const entities::StopBusList& stop_info, int request_id)const;
+    json::Dict ConvertNearestStopsToJson(const std::vector<entities::NearbyStop>& stops, int request_id)const;
+    json::Dict ConvertAreaInfoToJson(const entities::AreaObjectList& area_info, int request_id)const;
+    json::Dict ConvertSuggestionsToJson(const entities::NameSuggestions& suggestions, int request_id)const;
+    json::Dict ConvertSegmentToJson(const entities::RouteSegment& segment, int request_id)const;
+    json::Dict ConvertCommonBusesToJson(const entities::CommonBusList& common, int request_id)const;
+    json::Dict ConvertTransfersToJson(const entities::TransferReach& reach, int request_id)const;
+    json::Dict ConvertMapToJson(const std::string& map, int request_id)const;
+    spatial::BoundingBox ReadBoundingBox(const json::Dict& request)const;
 
 private:
     std::deque<CommandInfo> input_commands_;
     json::Array output_json_;
 
     map::MapRender renderer_data_;
+
+    std::ostream* output_ = &std::cout;
+    unsigned index_threads_ = parallel::DefaultThreadCount();
+    bool stream_answers_ = false;
+
+    bool precompute_answers_ = false;
+    // Valid for this catalogue at this version
+    const transport_catalogue::TransportCatalogue* cached_catalogue_ = nullptr;
+    uint64_t cached_version_ = 0;
+    answers::AnswerCache bus_answers_;
+    answers::AnswerCache stop_answers_;
+    std::string answer_text_;
 };
@@ -1,23 +1,286 @@
+#include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "../src/async_writer.h"
+#include "../src/instrumentation.h"
 #include "../src/json.h"
 #include "../src/json_builder.h"
 #include "../src/json_reader.h"
+#include "../src/parallel.h"
 #include "../src/svg.h"
 #include "../src/transport_catalogue.h"
 
 using namespace std::string_literals;
 using namespace json;
 
-int main() {
+struct LaunchOptions{
+    bool print_stats = false;
+    bool account_memory = false;
+    std::string stats_path; // stderr when empty
+
+    unsigned parse_threads = 0; // base_requests are parsed in parallel when set
+    bool precompute_answers = false; // every Bus and Stop answer is printed once before the stat requests
+
+    // Batch mode: input files, directories of them or files listing them, one path per line
+    std::vector<std::string> batch_sources;
+    unsigned batch_threads = 0; // all hardware threads when not set
+    std::string output_dir; // outputs go next to their inputs when empty
+};
+
+const char* const USAGE =
+    "Usage: transport_catalogue [options] < input.json\n"
+    "       transport_catalogue --batch=PATH [--batch-threads=N] [--output-dir=DIR] [options]\n"
+    "Options:\n"
+    "  --stats[=FILE]          print timings and counters to stderr or FILE\n"
+    "  --memory                add heap usage of every structure to the report\n"
+    "  --parallel-parse[=N]    parse base_requests on N threads, all by default\n"
+    "  --precompute-answers    print every Bus and Stop answer once up front\n"
+    "  --batch=PATH            process a directory, .json file or list of inputs\n"
+    "  --batch-threads=N       batch worker threads, all by default\n"
+    "  --output-dir=DIR        where batch outputs go, next to inputs by default\n";
+
+// Empty after printing the usage when an option is unknown or its value is not a number
+std::optional<LaunchOptions> ParseLaunchOptions(int argc, char** argv){
+    LaunchOptions options;
+    for(int i = 1; i < argc; ++i){
+        std::string argument = argv[i];
+
+        try{
+            if(argument == "--stats"){
+                options.print_stats = true;
+            }else if(argument.rfind("--stats=", 0) == 0){
+                options.print_stats = true;
+                options.stats_path = argument.substr("--stats="s.size());
+            }else if(argument == "--memory"){
+                options.account_memory = true;
+            }else if(argument == "--parallel-parse"){
+                options.parse_threads = std::max(1u, std::thread::hardware_concurrency());
+            }else if(argument.rfind("--parallel-parse=", 0) == 0){
+                options.parse_threads = std::max(1, std::stoi(argument.substr("--parallel-parse="s.size())));
+            }else if(argument == "--precompute-answers"){
+                options.precompute_answers = true;
+            }else if(argument.rfind("--batch=", 0) == 0){
+                options.batch_sources.push_back(argument.substr("--batch="s.size()));
+            }else if(argument.rfind("--batch-threads=", 0) == 0){
+                options.batch_threads = std::max(1, std::stoi(argument.substr("--batch-threads="s.size())));
+            }else if(argument.rfind("--output-dir=", 0) == 0){
+                options.output_dir = argument.substr("--output-dir="s.size());
+            }else{
+                std::cerr << "Unknown option "s << argument << "\n"s << USAGE;
+                return std::nullopt;
+            }
+        }catch(const std::logic_error&){
+            // std::stoi throws invalid_argument and out_of_range, both logic errors
+            std::cerr << "Invalid number in "s << argument << "\n"s << USAGE;
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+// ---------------- Batch mode --------------------------
+namespace fs = std::filesystem;
+
+const std::string OUTPUT_SUFFIX = ".out.json"s;
+
+bool IsBatchOutput(const fs::path& path){
+    const std::string name = path.filename().string();
+    return name.size() >= OUTPUT_SUFFIX.size()
+        && name.compare(name.size() - OUTPUT_SUFFIX.size(), OUTPUT_SUFFIX.size(), OUTPUT_SUFFIX) == 0;
+}
+
+// Every *.json file of a directory, outputs of a previous run skipped, in name order.
+// Any other path is a .json input itself or a list of inputs, one per line
+std::vector<fs::path> CollectBatchInputs(const std::vector<std::string>& sources){
+    std::vector<fs::path> inputs;
+    for(const auto& source : sources){
+        if(fs::is_directory(source)){
+            std::vector<fs::path> directory_inputs;
+            for(const auto& entry : fs::directory_iterator(source)){
+                if(entry.is_regular_file() && entry.path().extension() == ".json" && !IsBatchOutput(entry.path())){
+                    directory_inputs.push_back(entry.path());
+                }
+            }
+            std::sort(directory_inputs.begin(), directory_inputs.end());
+            inputs.insert(inputs.end(), directory_inputs.begin(), directory_inputs.end());
+        }else if(fs::path(source).extension() == ".json"){
+            inputs.emplace_back(source);
+        }else{
+            std::ifstream list(source);
+            if(!list){
+                throw std::runtime_error("Cannot open "s + source);
+            }
+            for(std::string line; std::getline(list, line);){
+                if(!line.empty()){
+                    inputs.emplace_back(line);
+                }
+            }
+        }
+    }
+    return inputs;
+}
+
+// region.json gives region.out.json
+fs::path BatchOutputPath(const fs::path& input, const std::string& output_dir){
+    fs::path directory = output_dir.empty() ? input.parent_path() : fs::path(output_dir);
+    return directory / (input.stem().string() + OUTPUT_SUFFIX);
+}
+
+// One input file with its own catalogue and renderer
+void RunBatchJob(const fs::path& input, const fs::path& output_path, const LaunchOptions& options){
+    std::ifstream input_stream(input, std::ios::binary);
+    if(!input_stream){
+        throw std::runtime_error("cannot open input");
+    }
+    std::ofstream output_stream(output_path, std::ios::binary);
+    if(!output_stream){
+        throw std::runtime_error("cannot create "s + output_path.string());
+    }
+
+    io::AsyncWriter async_output(output_stream);
+    std::ostream output(&async_output);
+
     transport_catalogue::TransportCatalogue catalogue;
-    JsonReader json_input;
+    JsonReader json_input(output);
+    json_input.SetStreamAnswers(true);
+    json_input.SetPrecomputeAnswers(options.precompute_answers);
+    // Jobs already keep every thread busy
+    json_input.SetIndexThreadCount(1);
+
+    if(options.parse_threads > 0){
+        std::string document{std::istreambuf_iterator<char>(input_stream), std::istreambuf_iterator<char>()};
+        json_input.ExecuteJsonQuery(document, catalogue, options.parse_threads);
+    }else{
+        std::optional<json::Document> document;
+        {
+            stats::ScopedTimer timer(stats::MetricKind::PHASE, "json_load");
+            document = json::Load(input_stream);
+        }
+        json_input.ExecuteJsonQuery(document->GetRoot(), catalogue);
+    }
+
+    if(!output.flush()){
+        throw std::runtime_error("cannot write "s + output_path.string());
+    }
+}
+
+// Failed inputs are reported on stderr and do not stop the others, returns the exit code
+int RunBatch(const LaunchOptions& options){
+    std::vector<fs::path> inputs;
+    try{
+        inputs = CollectBatchInputs(options.batch_sources);
+    }catch(const std::exception& error){
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<fs::path> outputs;
+    outputs.reserve(inputs.size());
+    for(const auto& input : inputs){
+        outputs.push_back(BatchOutputPath(input, options.output_dir));
+    }
+    std::vector<fs::path> sorted_outputs = outputs;
+    std::sort(sorted_outputs.begin(), sorted_outputs.end());
+    auto duplicate = std::adjacent_find(sorted_outputs.begin(), sorted_outputs.end());
+    if(duplicate != sorted_outputs.end()){
+        std::cerr << "Several inputs would be written to "s << duplicate->string() << std::endl;
+        return 1;
+    }
+
+    if(options.account_memory){
+        std::cerr << "--memory is not supported in batch mode"s << std::endl;
+    }
+
+    const unsigned thread_count = options.batch_threads > 0 ? options.batch_threads : parallel::DefaultThreadCount();
+    std::vector<std::string> errors(inputs.size());
+
+    parallel::ForEachIndex(inputs.size(), thread_count, [&](size_t index){
+        try{
+            RunBatchJob(inputs[index], outputs[index], options);
+        }catch(const std::exception& error){
+            errors[index] = error.what();
+            // No partial answers left behind
+            std::error_code ignored;
+            fs::remove(outputs[index], ignored);
+        }
+    });
+
+    size_t failed = 0;
+    for(size_t index = 0; index < inputs.size(); ++index){
+        if(!errors[index].empty()){
+            std::cerr << inputs[index].string() << ": "s << errors[index] << std::endl;
+            ++failed;
+        }
+    }
+    std::cerr << "Processed "s << inputs.size() - failed << " of "s << inputs.size() << " inputs"s << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    const std::optional<LaunchOptions> parsed_options = ParseLaunchOptions(argc, argv);
+    if(!parsed_options){
+        return 2;
+    }
+    const LaunchOptions& options = *parsed_options;
+    if(options.print_stats){
+        stats::Registry::Instance().Enable();
+    }
+    if(!options.batch_sources.empty()){
+        int exit_code = RunBatch(options);
+        if(options.print_stats){
+            stats::PrintReport(options.stats_path);
+        }
+        return exit_code;
+    }
+
+    if(options.account_memory){
+        stats::Registry::Instance().EnableMemory();
+    }
+
+    // Answers are written out on another thread while the next ones are computed
+    io::AsyncWriter async_output(std::cout);
+    std::ostream output(&async_output);
+
+    transport_catalogue::TransportCatalogue catalogue;
+    JsonReader json_input(output);
+    // Memory accounting measures the whole response
+    json_input.SetStreamAnswers(!options.account_memory);
+    json_input.SetPrecomputeAnswers(options.precompute_answers);
+
+    if(options.parse_threads > 0){
+        std::string document{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+        json_input.ExecuteJsonQuery(document, catalogue, options.parse_threads);
+    }else{
+        std::optional<json::Document> test_node;
+        {
+            stats::ScopedTimer timer(stats::MetricKind::PHASE, "json_load");
+            test_node = json::Load(std::cin);
+        }
+        json_input.ExecuteJsonQuery(test_node->GetRoot(), catalogue);
+
+        if(options.account_memory){
+            stats::Registry::Instance().RecordMemory("json_document", json::HeapUsage(test_node->GetRoot()));
+        }
+    }
+
+    output.flush();
 
-    json::Document test_node = json::Load(std::cin);
-    json_input.ExecuteJsonQuery(test_node.GetRoot(), catalogue);
+    if(options.account_memory){
+        stats::Registry::Instance().RecordMemory("catalogue", catalogue.GetMemoryUsage());
+    }
 
+    if(options.print_stats || options.account_memory){
+        stats::PrintReport(options.stats_path);
+    }
     return 0;
 }
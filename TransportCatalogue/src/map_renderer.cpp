@@ -2,7 +2,7 @@
 
 template <typename PointInputIt>
 SphereProjector::SphereProjector(PointInputIt points_begin, PointInputIt points_end, double max_width,
-                    double max_height, double padding) : padding_(padding) {
+                    double max_height, double padding) : offset_(padding, padding) {
     if (points_begin == points_end) {
         return;
     }
@@ -41,8 +41,23 @@ SphereProjector::SphereProjector(PointInputIt points_begin, PointInputIt points_
 }
 
 svg::Point SphereProjector::operator()(geo::Coordinates coords) const {
-    return {(coords.lng - min_lon_) * zoom_coeff_ + padding_,
-            (max_lat_ - coords.lat) * zoom_coeff_ + padding_};
+    return {(coords.lng - min_lon_) * zoom_coeff_ + offset_.x,
+            (max_lat_ - coords.lat) * zoom_coeff_ + offset_.y};
+}
+
+geo::Coordinates SphereProjector::Unproject(svg::Point point) const {
+    if(zoom_coeff_ == 0){
+        return {max_lat_, min_lon_};
+    }
+    return {max_lat_ - (point.y - offset_.y) / zoom_coeff_,
+            min_lon_ + (point.x - offset_.x) / zoom_coeff_};
+}
+
+SphereProjector SphereProjector::Zoomed(double scale, svg::Point origin) const {
+    SphereProjector result = *this;
+    result.zoom_coeff_ = zoom_coeff_ * scale;
+    result.offset_ = {(offset_.x - origin.x) * scale, (offset_.y - origin.y) * scale};
+    return result;
 }
 
 namespace map{
@@ -54,41 +69,108 @@ void MapRender::RenderObjects(std::ostream& out) const {
     objects_.Render(out);
 }
 
+memory::Report MapRender::GetMemoryUsage() const {
+    memory::Report report;
+    report["svg_document"] = objects_.HeapUsage();
+
+    size_t tile_cache = memory::HeapUsage(tile_cache_) + memory::HeapUsage(tile_uses_);
+    for(const auto& [tile, cached] : tile_cache_){
+        tile_cache += memory::HeapUsage(cached.map);
+    }
+    report["tile_cache"] = tile_cache;
+
+    return report;
+}
+
 // ---------- Adding Objects ------------------
-void MapRender::AddRenderData(const std::vector<entities::BusRouteRenderInfo>& bus_routes){
-    SetSphereProjector(bus_routes);
+void MapRender::AddRenderData(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                              const geo::CoordinateTable& coordinates){
+    objects_.Clear();
+    SetSphereProjector(bus_routes, coordinates);
 
-    std::map<std::string_view, svg::Point> sorted_stops;
+    std::vector<entities::StopPtr> stops;
+    for(const auto& route : bus_routes){
+        stops.insert(stops.end(), route.stops.begin(), route.stops.end());
+    }
+    AddObjects(bus_routes, stops, coordinates, nullptr);
+}
 
-    // Line - route
-    for(size_t i = 0; i < bus_routes.size(); ++i){
-        int color_id = i % render_settings_.color_palette.size();
-        svg::Color color = render_settings_.color_palette[color_id];
+void MapRender::AddViewportRenderData(const entities::ViewportRenderInfo& viewport, const geo::CoordinateTable& coordinates,
+                                      const spatial::BoundingBox& box){
+    objects_.Clear();
 
-        AddBusRoute(bus_routes[i].stops, color);
+    std::vector<geo::Coordinates> corners = {box.min, box.max};
+    sphere_ = SphereProjector(corners.begin(), corners.end(), render_settings_.width,
+                              render_settings_.height, render_settings_.padding);
 
-        for(const auto& stop : bus_routes[i].stops){
-            sorted_stops.emplace(stop->name, CalculateLocation(stop->location));
-        }
+    AddObjects(viewport.routes, viewport.stops, coordinates, &box);
+}
+
+spatial::BoundingBox MapRender::SetTileProjector(const spatial::BoundingBox& map_bounds, const TileAddress& tile){
+    std::vector<geo::Coordinates> corners = {map_bounds.min, map_bounds.max};
+    SphereProjector map_sphere(corners.begin(), corners.end(), render_settings_.width,
+                               render_settings_.height, render_settings_.padding);
+
+    const double scale = std::ldexp(1.0, tile.zoom);
+    const double tile_width = render_settings_.width / scale;
+    const double tile_height = render_settings_.height / scale;
+    const svg::Point origin = {tile.x * tile_width, tile.y * tile_height};
+
+    sphere_ = map_sphere.Zoomed(scale, origin);
+
+    // Stops just outside the tile still overlap it with their circles and lines
+    const double margin = std::max(render_settings_.line_width, render_settings_.stop_radius) / scale;
+    geo::Coordinates top_left = map_sphere.Unproject({origin.x - margin, origin.y - margin});
+    geo::Coordinates bottom_right = map_sphere.Unproject({origin.x + tile_width + margin,
+                                                          origin.y + tile_height + margin});
+
+    return {{bottom_right.lat, top_left.lng}, {top_left.lat, bottom_right.lng}};
+}
+
+void MapRender::AddTileRenderData(const entities::ViewportRenderInfo& viewport, const geo::CoordinateTable& coordinates,
+                                  const spatial::BoundingBox& box){
+    objects_.Clear();
+    AddObjects(viewport.routes, viewport.stops, coordinates, &box);
+}
+
+void MapRender::AddObjects(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                           const std::vector<entities::StopPtr>& stops, const geo::CoordinateTable& coordinates,
+                           const spatial::BoundingBox* viewport){
+    std::map<std::string_view, svg::Point> sorted_stops;
+    for(const auto& stop : stops){
+        sorted_stops.emplace(stop->name, CalculateLocation(coordinates.Get(stop->id)));
+    }
+
+    if(render_settings_.compact_styles){
+        objects_.Add(MakeStyle());
+        labels_ = std::make_unique<svg::Definitions>();
+    }
+
+    // Line - route
+    for(const auto& route : bus_routes){
+        size_t color_id = route.route_index % render_settings_.color_palette.size();
+        AddBusRoute(route.stops, route.route_cirular, coordinates, color_id);
     }
 
     // Text - Bus name
-    for(size_t i = 0; i < bus_routes.size(); ++i){
-        int color_id = i % render_settings_.color_palette.size();
-        svg::Color color = render_settings_.color_palette[color_id];
+    auto is_visible = [viewport](const geo::Coordinates& location){
+        return viewport == nullptr || viewport->Contains(location);
+    };
 
-        geo::Coordinates first_stop = bus_routes[i].stops.front()->location;
+    for(const auto& route : bus_routes){
+        size_t color_id = route.route_index % render_settings_.color_palette.size();
 
-        if(bus_routes[i].route_cirular){
-            AddBusRouteName(bus_routes[i].name, first_stop, color);
-        }else{
-            AddBusRouteName(bus_routes[i].name, first_stop, color);
+        geo::Coordinates first_stop = coordinates.Get(route.stops.front()->id);
+
+        if(is_visible(first_stop)){
+            AddBusRouteName(route.name, first_stop, color_id);
+        }
 
-            int end_stop = bus_routes[i].stops.size() / 2;
-            geo::Coordinates last_stop = bus_routes[i].stops[end_stop]->location;
+        if(!route.route_cirular){
+            geo::Coordinates last_stop = coordinates.Get(route.stops.back()->id);
 
-            if(first_stop.lat != last_stop.lat || first_stop.lng != last_stop.lng){
-                AddBusRouteName(bus_routes[i].name, last_stop, color);
+            if((first_stop.lat != last_stop.lat || first_stop.lng != last_stop.lng) && is_visible(last_stop)){
+                AddBusRouteName(route.name, last_stop, color_id);
             }
         }
     }
@@ -102,24 +184,207 @@ void MapRender::AddRenderData(const std::vector<entities::BusRouteRenderInfo>& b
     for(const auto& [name, location] : sorted_stops){
         AddStopName(std::string(name), location);
     }
+
+    if(labels_ && labels_->Size() > 0){
+        objects_.AddPtr(std::move(labels_));
+    }
+    labels_.reset();
+}
+
+// ---------- Compact styles ------------------
+svg::Style MapRender::MakeStyle() const {
+    std::ostringstream rules;
+    auto print_color = [&rules](const svg::Color& color){
+        std::visit(svg::ColorPrinter{rules}, color);
+    };
+
+    rules << ".route{fill:none;stroke-width:" << render_settings_.line_width
+          << ";stroke-linecap:round;stroke-linejoin:round}";
+    rules << ".stop{fill:white}";
+    rules << ".bus-name{font-family:Verdana;font-weight:bold;font-size:" << render_settings_.bus_label_font_size << "px}";
+    rules << ".stop-name{font-family:Verdana;font-size:" << render_settings_.stop_label_font_size << "px}";
+    rules << ".stop-name-fill{fill:black}";
+
+    rules << ".under{fill:";
+    print_color(render_settings_.underlayer_color);
+    rules << ";stroke:";
+    print_color(render_settings_.underlayer_color);
+    rules << ";stroke-width:" << render_settings_.underlayer_width << ";stroke-linecap:round;stroke-linejoin:round}";
+
+    // Palette colors as line stroke and as label fill
+    for(size_t i = 0; i < render_settings_.color_palette.size(); ++i){
+        rules << ".c" << i << "{stroke:";
+        print_color(render_settings_.color_palette[i]);
+        rules << "}.f" << i << "{fill:";
+        print_color(render_settings_.color_palette[i]);
+        rules << "}";
+    }
+    return svg::Style().SetRules(rules.str());
+}
+
+void MapRender::AddLabel(svg::Text text, const std::string& fill_class){
+    std::string id = "l"s + std::to_string(labels_->Size());
+    labels_->Add(text.SetId(id));
+    objects_.Add(svg::Use().SetHref(id).SetClass("under"s));
+    objects_.Add(svg::Use().SetHref(id).SetClass(fill_class));
+}
+
+// ---------- Tile cache ------------------
+const std::string* MapRender::FindCachedTile(const TileAddress& tile, uint64_t catalogue_version){
+    if(catalogue_version != tile_cache_version_){
+        return nullptr;
+    }
+    auto it = tile_cache_.find(tile);
+    if(it == tile_cache_.end()){
+        return nullptr;
+    }
+    tile_uses_.splice(tile_uses_.begin(), tile_uses_, it->second.use);
+    return &it->second.map;
+}
+
+void MapRender::CacheTile(const TileAddress& tile, uint64_t catalogue_version, std::string map){
+    // Tiles of older catalogue versions can't be requested anymore
+    if(catalogue_version != tile_cache_version_){
+        tile_cache_.clear();
+        tile_uses_.clear();
+        tile_cache_version_ = catalogue_version;
+    }
+
+    auto it = tile_cache_.find(tile);
+    if(it != tile_cache_.end()){
+        it->second.map = std::move(map);
+        tile_uses_.splice(tile_uses_.begin(), tile_uses_, it->second.use);
+        return;
+    }
+    if(tile_cache_.size() >= TILE_CACHE_CAPACITY){
+        tile_cache_.erase(tile_uses_.back());
+        tile_uses_.pop_back();
+    }
+    tile_uses_.push_front(tile);
+    tile_cache_.emplace(tile, CachedTile{std::move(map), tile_uses_.begin()});
 }
 
 // --------------Route line---------------------
-void MapRender::AddBusRoute(const std::vector<entities::StopPtr>& stops, svg::Color fill_color){
-    Polyline route;
+void MapRender::AddBusRoute(const std::vector<entities::StopPtr>& stops, bool circular,
+                            const geo::CoordinateTable& coordinates, size_t color_index){
+    std::vector<svg::Point> points;
     for(const auto& stop : stops){
-        route.AddPoint(CalculateLocation(stop->location));
+        points.push_back(CalculateLocation(coordinates.Get(stop->id)));
+    }
+    if(render_settings_.simplify_tolerance > 0.0){
+        points = SimplifyPolyline(std::move(points), render_settings_.simplify_tolerance);
+    }
+    // Line goes back to the first stop
+    if(!circular && !points.empty()){
+        points.insert(points.end(), points.rbegin() + 1, points.rend());
+    }
+
+    auto add_route = [&](auto route){
+        for(const auto& point : points){
+            route.AddPoint(point);
+        }
+        if(render_settings_.compact_styles){
+            route.SetClass("route c"s + std::to_string(color_index));
+        }else{
+            route.SetFillColor(NoneColor)
+                 .SetStrokeColor(render_settings_.color_palette[color_index])
+                 .SetStrokeWidth(render_settings_.line_width)
+                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+                 .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        }
+        objects_.Add(std::move(route));
+    };
+
+    if(render_settings_.route_paths){
+        add_route(Path().SetPrecision(render_settings_.coordinate_precision));
+    }else{
+        add_route(Polyline());
     }
-    route.SetFillColor(NoneColor)
-         .SetStrokeColor(fill_color)
-         .SetStrokeWidth(render_settings_.line_width)
-         .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-         .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-    objects_.Add(route);
+}
+
+// ---------- Level of detail ------------------
+namespace{
+
+double SquaredDistance(svg::Point from, svg::Point to){
+    const double dx = to.x - from.x;
+    const double dy = to.y - from.y;
+    return dx * dx + dy * dy;
+}
+
+// From point to the segment between begin and end, which may be a single point
+double SquaredSegmentDistance(svg::Point point, svg::Point begin, svg::Point end){
+    const double length = SquaredDistance(begin, end);
+    if(length == 0.0){
+        return SquaredDistance(point, begin);
+    }
+    double t = ((point.x - begin.x) * (end.x - begin.x) + (point.y - begin.y) * (end.y - begin.y)) / length;
+    t = std::clamp(t, 0.0, 1.0);
+    return SquaredDistance(point, {begin.x + t * (end.x - begin.x), begin.y + t * (end.y - begin.y)});
+}
+
+}
+
+std::vector<svg::Point> SimplifyPolyline(std::vector<svg::Point> points, double tolerance){
+    if(points.size() < 3){
+        return points;
+    }
+    const double squared_tolerance = tolerance * tolerance;
+
+    // Runs of stops drawn on about the same pixel collapse into their first one
+    size_t kept = 1;
+    for(size_t i = 1; i + 1 < points.size(); ++i){
+        if(SquaredDistance(points[kept - 1], points[i]) > squared_tolerance){
+            points[kept++] = points[i];
+        }
+    }
+    points[kept++] = points.back();
+    points.resize(kept);
+
+    // Douglas-Peucker: the point farthest from the chord of a range splits it while it is out of tolerance
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> ranges = {{0, points.size() - 1}};
+    while(!ranges.empty()){
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+
+        double max_distance = 0.0;
+        size_t farthest = first;
+        for(size_t i = first + 1; i < last; ++i){
+            const double distance = SquaredSegmentDistance(points[i], points[first], points[last]);
+            if(distance > max_distance){
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+        if(max_distance > squared_tolerance){
+            keep[farthest] = true;
+            ranges.emplace_back(first, farthest);
+            ranges.emplace_back(farthest, last);
+        }
+    }
+
+    kept = 0;
+    for(size_t i = 0; i < points.size(); ++i){
+        if(keep[i]){
+            points[kept++] = points[i];
+        }
+    }
+    points.resize(kept);
+    return points;
 }
 
 // --------------Bus Name---------------------
-void MapRender::AddBusRouteName(const std::string& name, const geo::Coordinates location, svg::Color fill_color){
+void MapRender::AddBusRouteName(const std::string& name, const geo::Coordinates location, size_t color_index){
+    if(render_settings_.compact_styles){
+        AddLabel(Text()
+                    .SetPosition(CalculateLocation(location))
+                    .SetOffset(render_settings_.bus_label_offset)
+                    .SetData(name)
+                    .SetClass("bus-name"s), "f"s + std::to_string(color_index));
+        return;
+    }
     objects_.Add(Text()
                     .SetFontFamily("Verdana"s)
                     .SetPosition(CalculateLocation(location))
@@ -139,11 +404,18 @@ void MapRender::AddBusRouteName(const std::string& name, const geo::Coordinates
                     .SetFontSize(render_settings_.bus_label_font_size)
                     .SetFontWeight("bold"s)
                     .SetData(name)
-                    .SetFillColor(fill_color));
+                    .SetFillColor(render_settings_.color_palette[color_index]));
 }
 
 // --------------Stop Circle---------------------
 void MapRender::AddStopCircle(const svg::Point location){
+    if(render_settings_.compact_styles){
+        objects_.Add(Circle()
+                        .SetCenter(location)
+                        .SetRadius(render_settings_.stop_radius)
+                        .SetClass("stop"s));
+        return;
+    }
     objects_.Add(Circle()
                     .SetCenter(location)
                     .SetRadius(render_settings_.stop_radius)
@@ -152,6 +424,14 @@ void MapRender::AddStopCircle(const svg::Point location){
 
 // --------------Stop Name---------------------
 void MapRender::AddStopName(const std::string& name, const svg::Point location){
+    if(render_settings_.compact_styles){
+        AddLabel(Text()
+                    .SetPosition(location)
+                    .SetOffset(render_settings_.stop_label_offset)
+                    .SetData(name)
+                    .SetClass("stop-name"s), "stop-name-fill"s);
+        return;
+    }
     objects_.Add(Text()
                     .SetFontFamily("Verdana"s)
                     .SetPosition(location)
@@ -174,6 +454,10 @@ void MapRender::AddStopName(const std::string& name, const svg::Point location){
 
 // ---------- Render Setting------------------
 void MapRender::SetRenderSettings(const json::Dict& node){
+    render_settings_ = {};
+    tile_cache_.clear();
+    tile_uses_.clear();
+
     render_settings_.height = node.at("height").AsDouble();
     render_settings_.width = node.at("width").AsDouble();
 
@@ -195,6 +479,19 @@ void MapRender::SetRenderSettings(const json::Dict& node){
     for(const auto& color : node.at("color_palette").AsArray()){
         render_settings_.color_palette.push_back(CheckColorType(color));
     }
+
+    if(node.count("compact_styles") > 0){
+        render_settings_.compact_styles = node.at("compact_styles").AsBool();
+    }
+    if(node.count("coordinate_precision") > 0){
+        render_settings_.coordinate_precision = node.at("coordinate_precision").AsDouble();
+    }
+    if(node.count("route_paths") > 0){
+        render_settings_.route_paths = node.at("route_paths").AsBool();
+    }
+    if(node.count("simplify_tolerance") > 0){
+        render_settings_.simplify_tolerance = node.at("simplify_tolerance").AsDouble();
+    }
 }
 
 svg::Color MapRender::CheckColorType(const json::Node& node)const{
@@ -215,12 +512,13 @@ svg::Color MapRender::CheckColorType(const json::Node& node)const{
     }
 }
 
-void MapRender::SetSphereProjector(const std::vector<entities::BusRouteRenderInfo>& bus_routes){
+void MapRender::SetSphereProjector(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                                   const geo::CoordinateTable& coordinates){
     std::vector<geo::Coordinates> all_coordinates;
 
     for(const auto& route : bus_routes){
         for(const auto& stop : route.stops){
-            all_coordinates.push_back(stop->location);
+            all_coordinates.push_back(coordinates.Get(stop->id));
         }
     }
     SphereProjector sphere(all_coordinates.begin(), all_coordinates.end(), render_settings_.width,
@@ -230,6 +528,13 @@ void MapRender::SetSphereProjector(const std::vector<entities::BusRouteRenderInf
 }
 
 svg::Point MapRender::CalculateLocation(const geo::Coordinates& location)const {
-    return sphere_(location);
+    svg::Point point = sphere_(location);
+
+    const double step = render_settings_.coordinate_precision;
+    if(step > 0.0){
+        point.x = std::round(point.x / step) * step;
+        point.y = std::round(point.y / step) * step;
+    }
+    return point;
 }
 }
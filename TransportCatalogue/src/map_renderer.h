@@ -2,11 +2,19 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
 
 #include "../src/domain.h"
 #include "../src/geo.h"
 #include "../src/json.h"
+#include "../src/memory_usage.h"
+#include "../src/spatial_index.h"
 #include "../src/svg.h"
 
 inline const double EPSILON = 1e-6;
@@ -19,9 +27,13 @@ public:
 SphereProjector(PointInputIt points_begin, PointInputIt points_end, double max_width, double max_height, double padding);
 
     svg::Point operator()(geo::Coordinates coords) const;
+    geo::Coordinates Unproject(svg::Point point) const;
+
+    // Same projection magnified by scale, with origin moved to the top left corner
+    SphereProjector Zoomed(double scale, svg::Point origin) const;
 
 private:
-    double padding_ = 0;
+    svg::Point offset_ = {0.0, 0.0};
     double min_lon_ = 0;
     double max_lat_ = 0;
     double zoom_coeff_ = 0;
@@ -51,14 +63,68 @@ struct RenderSetting{
     double underlayer_width = 1.0;
 
     std::vector<svg::Color> color_palette;
+
+    // Shared presentation goes to <style> classes and every label text is written once,
+    // its underlayer and foreground are drawn through <use>
+    bool compact_styles = false;
+
+    // Output coordinates are rounded to multiples of this step in px, 0 keeps them exact
+    double coordinate_precision = 0.0;
+    // Routes are written as <path> of relative moves instead of <polyline>
+    bool route_paths = false;
+    // Route vertices that change the drawn line by at most this many px are dropped, 0 keeps them all.
+    // Measured on the canvas, so zoomed in tiles keep more of them
+    double simplify_tolerance = 0.0;
+};
+
+// Tile z/x/y splits the full map canvas into 2^z x 2^z equal tiles,
+// each one is rendered at the full canvas size
+struct TileAddress{
+    int zoom = 0;
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const TileAddress& other) const {
+        return zoom == other.zoom && x == other.x && y == other.y;
+    }
+};
+
+struct TileAddressHasher{
+    size_t operator()(const TileAddress& tile) const {
+        return (static_cast<size_t>(tile.zoom) << 58) ^ (static_cast<size_t>(tile.x) << 29) ^ static_cast<size_t>(tile.y);
+    }
 };
 
+// Drops polyline vertices in two passes: points within tolerance of the previous kept point,
+// then Douglas-Peucker over the rest. Each pass moves the line by at most tolerance, both ends stay
+std::vector<svg::Point> SimplifyPolyline(std::vector<svg::Point> points, double tolerance);
+
+inline const int MAX_TILE_ZOOM = 28;
+inline const size_t TILE_CACHE_CAPACITY = 4096;
+
 class MapRender{
 public:
-    void AddRenderData(const std::vector<entities::BusRouteRenderInfo>& bus_routes);
-
-    void AddBusRouteName(const std::string& name, const geo::Coordinates location, svg::Color fill_color);
-    void AddBusRoute(const std::vector<entities::StopPtr>& stops, svg::Color fill_color);
+    // Stop locations are looked up by stop id in coordinates
+    void AddRenderData(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                       const geo::CoordinateTable& coordinates);
+    void AddViewportRenderData(const entities::ViewportRenderInfo& viewport, const geo::CoordinateTable& coordinates,
+                               const spatial::BoundingBox& box);
+
+    // Sets up projection for the tile, returns the area the tile covers
+    spatial::BoundingBox SetTileProjector(const spatial::BoundingBox& map_bounds, const TileAddress& tile);
+    void AddTileRenderData(const entities::ViewportRenderInfo& viewport, const geo::CoordinateTable& coordinates,
+                           const spatial::BoundingBox& box);
+
+    // A found tile becomes the most recently used one
+    const std::string* FindCachedTile(const TileAddress& tile, uint64_t catalogue_version);
+    // Past TILE_CACHE_CAPACITY the least recently used tile is evicted
+    void CacheTile(const TileAddress& tile, uint64_t catalogue_version, std::string map);
+
+    // Colors are given as positions in the palette
+    void AddBusRouteName(const std::string& name, const geo::Coordinates location, size_t color_index);
+    // A route that is not circular is drawn there and back
+    void AddBusRoute(const std::vector<entities::StopPtr>& stops, bool circular,
+                     const geo::CoordinateTable& coordinates, size_t color_index);
 
     void AddStopCircle(const svg::Point location);
     void AddStopName(const std::string& name, const svg::Point location);
@@ -67,9 +133,18 @@ public:
 
 public:
     void RenderObjects(std::ostream& out) const;
+    memory::Report GetMemoryUsage() const;
 
 private:
-    void SetSphereProjector(const std::vector<entities::BusRouteRenderInfo>& bus_routes);
+    void SetSphereProjector(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                            const geo::CoordinateTable& coordinates);
+    void AddObjects(const std::vector<entities::BusRouteRenderInfo>& bus_routes,
+                    const std::vector<entities::StopPtr>& stops, const geo::CoordinateTable& coordinates,
+                    const spatial::BoundingBox* viewport);
+
+    svg::Style MakeStyle() const;
+    // Adds the text to the label definitions, draws it over its underlayer
+    void AddLabel(svg::Text text, const std::string& fill_class);
 
 private:
     svg::Color CheckColorType(const json::Node& node)const;
@@ -78,6 +153,16 @@ private:
 private:
     RenderSetting render_settings_;
     svg::Document objects_;
+    std::unique_ptr<svg::Definitions> labels_;
     SphereProjector sphere_;
+
+    struct CachedTile{
+        std::string map;
+        std::list<TileAddress>::iterator use; // in tile_uses_
+    };
+
+    std::unordered_map<TileAddress, CachedTile, TileAddressHasher> tile_cache_;
+    std::list<TileAddress> tile_uses_; // most recently used first
+    uint64_t tile_cache_version_ = 0;
 };
 }
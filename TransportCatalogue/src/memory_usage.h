@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Estimates of heap bytes held by standard containers. They follow the usual
+// node layouts of libstdc++/libc++ and count malloc chunk headers and rounding,
+// so sums come close to what the structures add to RSS.
+namespace memory{
+
+using Report = std::map<std::string, size_t>;
+
+inline size_t AllocationSize(size_t bytes){
+    if(bytes == 0){
+        return 0;
+    }
+    return (bytes + sizeof(size_t) + 15) / 16 * 16;
+}
+
+inline size_t HeapUsage(const std::string& value){
+    // Short strings live inside the object, their buffer is part of it
+    const char* data = value.data();
+    const char* object = reinterpret_cast<const char*>(&value);
+    if(data >= object && data < object + sizeof(std::string)){
+        return 0;
+    }
+    return AllocationSize(value.capacity() + 1);
+}
+
+template <typename T>
+size_t HeapUsage(const std::vector<T>& values){
+    return AllocationSize(values.capacity() * sizeof(T));
+}
+
+template <typename T>
+size_t HeapUsage(const std::deque<T>& values){
+    // Elements are kept in 512 byte blocks plus a map of block pointers
+    const size_t per_block = std::max<size_t>(1, 512 / sizeof(T));
+    const size_t blocks = values.size() / per_block + 1;
+    return blocks * AllocationSize(per_block * sizeof(T)) + AllocationSize((blocks + 2) * sizeof(void*));
+}
+
+// Node per element: two links and the value
+template <typename T>
+size_t HeapUsage(const std::list<T>& values){
+    return values.size() * AllocationSize(2 * sizeof(void*) + sizeof(T));
+}
+
+// Buckets array plus one node per element: next pointer, value and cached hash
+template <typename Key, typename Value, typename Hash>
+size_t HeapUsage(const std::unordered_map<Key, Value, Hash>& values){
+    const size_t node = sizeof(void*) + sizeof(std::pair<const Key, Value>) + sizeof(size_t);
+    return AllocationSize(values.bucket_count() * sizeof(void*)) + values.size() * AllocationSize(node);
+}
+
+template <typename Key, typename Hash>
+size_t HeapUsage(const std::unordered_set<Key, Hash>& values){
+    const size_t node = sizeof(void*) + sizeof(Key) + sizeof(size_t);
+    return AllocationSize(values.bucket_count() * sizeof(void*)) + values.size() * AllocationSize(node);
+}
+
+// Red-black tree node: color, three links and the value
+template <typename Key, typename Compare>
+size_t HeapUsage(const std::set<Key, Compare>& values){
+    return values.size() * AllocationSize(4 * sizeof(void*) + sizeof(Key));
+}
+
+template <typename Key, typename Value, typename Compare>
+size_t HeapUsage(const std::map<Key, Value, Compare>& values){
+    return values.size() * AllocationSize(4 * sizeof(void*) + sizeof(std::pair<const Key, Value>));
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "../src/instrumentation.h"
+
+namespace parallel{
+
+inline unsigned DefaultThreadCount(){
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs task(0) .. task(task_count - 1) each on its own thread, the calling thread takes task 0.
+// Exceptions are collected and the one from the lowest task index is rethrown after all tasks end.
+// Allocations of the workers are added to the running timer of the calling thread once they end
+template <typename Task>
+void RunTasks(unsigned task_count, Task task){
+    std::vector<std::exception_ptr> errors(task_count);
+
+    stats::AllocationCounter* parent_allocations = stats::CurrentAllocations();
+    std::vector<stats::AllocationCounter> worker_allocations(parent_allocations != nullptr && task_count > 1 ? task_count : 0);
+
+    auto run = [&](unsigned index){
+        // Task 0 runs on the calling thread and counts there directly
+        stats::AllocationScope allocations(index == 0 || worker_allocations.empty()
+                                           ? parent_allocations : &worker_allocations[index]);
+        try{
+            task(index);
+        }catch(...){
+            errors[index] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(unsigned index = 1; index < task_count; ++index){
+        workers.emplace_back(run, index);
+    }
+    if(task_count > 0){
+        run(0);
+    }
+    for(auto& worker : workers){
+        worker.join();
+    }
+    for(const auto& allocations : worker_allocations){
+        parent_allocations->count += allocations.count;
+        parent_allocations->bytes += allocations.bytes;
+    }
+
+    for(const auto& error : errors){
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Runs item(0) .. item(item_count - 1) on thread_count threads, each thread takes the next
+// unclaimed index when it is done with the previous one. Exceptions are handled as in RunTasks
+template <typename Item>
+void ForEachIndex(size_t item_count, unsigned thread_count, Item item){
+    std::atomic<size_t> next_index{0};
+    const unsigned workers = static_cast<unsigned>(std::min<size_t>(std::max(1u, thread_count), item_count));
+
+    RunTasks(workers, [&](unsigned){
+        for(size_t index = next_index++; index < item_count; index = next_index++){
+            item(index);
+        }
+    });
+}
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../src/flat_hash_map.h"
+#include "../src/memory_usage.h"
+
+namespace flat{
+
+// Minimal perfect hash map from a fixed set of string keys, hash and displace scheme (CHD).
+// Keys are spread over buckets of about four, every bucket gets a displacement that sends its
+// keys to distinct free slots of an array with exactly one slot per key. A lookup hashes the key
+// once, reads the displacement of its bucket and compares the key stored in the single slot.
+template <typename Value>
+class PerfectHashMap{
+public:
+    // A key that repeats keeps its first value, as emplace into a map does.
+    // Throws std::invalid_argument when no perfect hash is found for the keys
+    void Build(const std::vector<std::pair<std::string_view, Value>>& entries){
+        const std::vector<bool> repeated = RepeatedKeys(entries);
+        if(std::find(repeated.begin(), repeated.end(), true) == repeated.end()){
+            BuildUnique(entries);
+            return;
+        }
+        std::vector<std::pair<std::string_view, Value>> unique_entries;
+        for(size_t i = 0; i < entries.size(); ++i){
+            if(!repeated[i]){
+                unique_entries.push_back(entries[i]);
+            }
+        }
+        BuildUnique(unique_entries);
+    }
+
+    const Value* Find(std::string_view key) const {
+        if(slots_.empty()){
+            return nullptr;
+        }
+        const uint64_t hash = HashKey(key, salt_);
+        const Slot& slot = slots_[Position(hash, displacements_[Bucket(hash)])];
+        return slot.key == key ? &slot.value : nullptr;
+    }
+
+    size_t Size() const {
+        return slots_.size();
+    }
+
+    size_t HeapUsage() const {
+        return memory::HeapUsage(slots_) + memory::HeapUsage(displacements_);
+    }
+
+private:
+    struct Slot{
+        std::string_view key;
+        Value value{};
+    };
+
+    // Displacements with this bit hold the slot of a single-key bucket directly
+    static constexpr uint32_t DIRECT_SLOT = 1u << 31;
+    static constexpr uint32_t MAX_DISPLACEMENT = 1u << 20;
+    static constexpr uint64_t MAX_SALTS = 16;
+    static constexpr size_t KEYS_PER_BUCKET = 4;
+
+    // FNV-1a seeded with the salt, finished with a mixer so every bit depends on the whole key
+    static uint64_t HashKey(std::string_view key, uint64_t salt){
+        uint64_t hash = 0xcbf29ce484222325ULL ^ (salt * 0x9e3779b97f4a7c15ULL);
+        for(unsigned char c : key){
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return IntegerHasher{}(hash);
+    }
+
+    // Maps 32 random bits onto [0, range) without a division
+    static size_t Reduce(uint64_t bits, size_t range){
+        return static_cast<size_t>(((bits & 0xFFFFFFFFu) * range) >> 32);
+    }
+
+    size_t Bucket(uint64_t hash) const {
+        return Reduce(hash >> 32, displacements_.size());
+    }
+
+    size_t Position(uint64_t hash, uint32_t displacement) const {
+        if(displacement & DIRECT_SLOT){
+            return displacement & ~DIRECT_SLOT;
+        }
+        return Reduce(IntegerHasher{}(hash + displacement * 0x9e3779b97f4a7c15ULL), slots_.size());
+    }
+
+    // Marks every entry whose key appeared earlier. Equal keys have equal hashes,
+    // so only entries next to each other in hash order are compared
+    static std::vector<bool> RepeatedKeys(const std::vector<std::pair<std::string_view, Value>>& entries){
+        std::vector<std::pair<uint64_t, size_t>> order(entries.size());
+        for(size_t i = 0; i < entries.size(); ++i){
+            order[i] = {HashKey(entries[i].first, 0), i};
+        }
+        std::sort(order.begin(), order.end());
+
+        std::vector<bool> repeated(entries.size(), false);
+        for(size_t begin = 0, end = 0; begin < order.size(); begin = end){
+            while(end < order.size() && order[end].first == order[begin].first){
+                ++end;
+            }
+            for(size_t i = begin + 1; i < end; ++i){
+                for(size_t j = begin; j < i; ++j){
+                    if(!repeated[order[j].second] && entries[order[j].second].first == entries[order[i].second].first){
+                        repeated[order[i].second] = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return repeated;
+    }
+
+    // Keys are unique here
+    void BuildUnique(const std::vector<std::pair<std::string_view, Value>>& entries){
+        if(entries.size() >= DIRECT_SLOT){
+            throw std::invalid_argument("Too many keys for a perfect hash");
+        }
+        for(uint64_t salt = 0; salt < MAX_SALTS; ++salt){
+            if(TryBuild(entries, salt)){
+                return;
+            }
+        }
+        throw std::invalid_argument("No perfect hash for the keys");
+    }
+
+    bool TryBuild(const std::vector<std::pair<std::string_view, Value>>& entries, uint64_t salt){
+        const size_t key_count = entries.size();
+        salt_ = salt;
+        slots_.assign(key_count, Slot{});
+        displacements_.assign(std::max<size_t>(1, (key_count + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET), 0);
+
+        // Keys of bucket b are bucket_keys[bucket_offsets[b] .. bucket_offsets[b + 1])
+        std::vector<uint64_t> hashes(key_count);
+        std::vector<uint32_t> bucket_offsets(displacements_.size() + 1, 0);
+        for(size_t i = 0; i < key_count; ++i){
+            hashes[i] = HashKey(entries[i].first, salt);
+            ++bucket_offsets[Bucket(hashes[i]) + 1];
+        }
+        for(size_t i = 1; i < bucket_offsets.size(); ++i){
+            bucket_offsets[i] += bucket_offsets[i - 1];
+        }
+        std::vector<uint32_t> bucket_keys(key_count);
+        std::vector<uint32_t> filled(bucket_offsets.begin(), bucket_offsets.end() - 1);
+        for(size_t i = 0; i < key_count; ++i){
+            bucket_keys[filled[Bucket(hashes[i])]++] = static_cast<uint32_t>(i);
+        }
+        auto bucket_size = [&bucket_offsets](uint32_t bucket){
+            return bucket_offsets[bucket + 1] - bucket_offsets[bucket];
+        };
+
+        // Large buckets go first, while the table is still mostly free
+        std::vector<uint32_t> order(displacements_.size());
+        for(size_t i = 0; i < order.size(); ++i){
+            order[i] = static_cast<uint32_t>(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&bucket_size](uint32_t left, uint32_t right){
+            return bucket_size(left) > bucket_size(right);
+        });
+
+        std::vector<bool> taken(key_count, false);
+        std::vector<size_t> positions;
+        size_t next_free = 0;
+
+        for(uint32_t bucket : order){
+            const uint32_t* keys_begin = bucket_keys.data() + bucket_offsets[bucket];
+            const uint32_t* keys_end = bucket_keys.data() + bucket_offsets[bucket + 1];
+            if(keys_begin == keys_end){
+                break;
+            }
+
+            if(keys_end - keys_begin == 1){
+                // No search needed, the bucket points at any free slot
+                while(taken[next_free]){
+                    ++next_free;
+                }
+                taken[next_free] = true;
+                displacements_[bucket] = DIRECT_SLOT | static_cast<uint32_t>(next_free);
+                continue;
+            }
+
+            uint32_t displacement = 0;
+            for(; displacement < MAX_DISPLACEMENT; ++displacement){
+                positions.clear();
+                bool placed = true;
+                for(const uint32_t* key = keys_begin; key != keys_end; ++key){
+                    size_t position = Position(hashes[*key], displacement);
+                    if(taken[position] || std::find(positions.begin(), positions.end(), position) != positions.end()){
+                        placed = false;
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if(placed){
+                    break;
+                }
+            }
+            if(displacement == MAX_DISPLACEMENT){
+                return false;
+            }
+
+            for(size_t position : positions){
+                taken[position] = true;
+            }
+            displacements_[bucket] = displacement;
+        }
+
+        for(size_t i = 0; i < key_count; ++i){
+            const uint64_t hash = hashes[i];
+            slots_[Position(hash, displacements_[Bucket(hash)])] = {entries[i].first, entries[i].second};
+        }
+        return true;
+    }
+
+private:
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> displacements_;
+    uint64_t salt_ = 0;
+};
+
+}
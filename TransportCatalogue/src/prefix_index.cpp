@@ -0,0 +1,96 @@
+#include "../src/prefix_index.h"
+
+namespace prefix{
+
+void PrefixIndex::Build(std::vector<std::pair<std::string_view, uint32_t>> ranked_names){
+    std::sort(ranked_names.begin(), ranked_names.end());
+
+    const size_t size = ranked_names.size();
+    names_.resize(size);
+    ranks_.resize(size);
+    for(size_t i = 0; i < size; ++i){
+        names_[i] = ranked_names[i].first;
+        ranks_[i] = ranked_names[i].second;
+    }
+
+    tree_.assign(2 * size, 0);
+    for(size_t i = 0; i < size; ++i){
+        tree_[size + i] = static_cast<uint32_t>(i);
+    }
+    for(size_t node = size; node-- > 1;){
+        tree_[node] = Better(tree_[2 * node], tree_[2 * node + 1]);
+    }
+}
+
+std::vector<NameMatch> PrefixIndex::Find(std::string_view prefix, size_t count) const{
+    std::vector<NameMatch> result;
+
+    auto begin = std::partition_point(names_.begin(), names_.end(), [prefix](std::string_view name){
+        return name < prefix;
+    });
+    auto end = std::partition_point(begin, names_.end(), [prefix](std::string_view name){
+        return name.substr(0, prefix.size()) == prefix;
+    });
+    if(count == 0 || begin == end){
+        return result;
+    }
+    result.reserve(std::min<size_t>(count, end - begin));
+
+    // Candidate ranges ordered by their best name, taking a name splits its range in two
+    struct Candidate{
+        uint32_t best;
+        size_t begin;
+        size_t end;
+    };
+    auto worse = [this](const Candidate& left, const Candidate& right){
+        return Better(left.best, right.best) == right.best;
+    };
+
+    std::vector<Candidate> heap;
+    const size_t first = begin - names_.begin();
+    const size_t last = end - names_.begin();
+    heap.push_back({BestInRange(first, last), first, last});
+
+    while(!heap.empty() && result.size() < count){
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        const Candidate candidate = heap.back();
+        heap.pop_back();
+
+        result.push_back({names_[candidate.best], ranks_[candidate.best]});
+
+        if(candidate.begin < candidate.best){
+            heap.push_back({BestInRange(candidate.begin, candidate.best), candidate.begin, candidate.best});
+            std::push_heap(heap.begin(), heap.end(), worse);
+        }
+        if(candidate.best + 1 < candidate.end){
+            heap.push_back({BestInRange(candidate.best + 1, candidate.end), candidate.best + 1, candidate.end});
+            std::push_heap(heap.begin(), heap.end(), worse);
+        }
+    }
+    return result;
+}
+
+size_t PrefixIndex::HeapUsage() const{
+    return memory::HeapUsage(names_) + memory::HeapUsage(ranks_) + memory::HeapUsage(tree_);
+}
+
+uint32_t PrefixIndex::Better(uint32_t left, uint32_t right) const{
+    if(ranks_[left] != ranks_[right]){
+        return ranks_[left] > ranks_[right] ? left : right;
+    }
+    return std::min(left, right);
+}
+
+uint32_t PrefixIndex::BestInRange(size_t begin, size_t end) const{
+    uint32_t best = static_cast<uint32_t>(begin);
+    for(begin += names_.size(), end += names_.size(); begin < end; begin /= 2, end /= 2){
+        if(begin % 2 == 1){
+            best = Better(best, tree_[begin++]);
+        }
+        if(end % 2 == 1){
+            best = Better(best, tree_[--end]);
+        }
+    }
+    return best;
+}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../src/domain.h"
+#include "../src/memory_usage.h"
+
+namespace prefix{
+using namespace entities;
+
+// Static autocomplete index. Names are kept sorted, so the names that start with a prefix form
+// one range found by two binary searches. A segment tree holds the best ranked name of every
+// range, the top names of a match are taken from it without scanning the whole match.
+class PrefixIndex{
+public:
+    // Names must outlive the index
+    void Build(std::vector<std::pair<std::string_view, uint32_t>> ranked_names);
+
+    // At most count names starting with prefix, higher rank first, equal ranks by name
+    std::vector<NameMatch> Find(std::string_view prefix, size_t count) const;
+
+    size_t HeapUsage() const;
+
+private:
+    // Index of the better ranked of two names
+    uint32_t Better(uint32_t left, uint32_t right) const;
+    // Best ranked name in [begin, end), the range is not empty
+    uint32_t BestInRange(size_t begin, size_t end) const;
+
+private:
+    std::vector<std::string_view> names_;
+    std::vector<uint32_t> ranks_;
+    std::vector<uint32_t> tree_; // node i covers nodes 2i and 2i + 1, leaves start at names_.size()
+};
+}
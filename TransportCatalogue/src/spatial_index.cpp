@@ -0,0 +1,203 @@
+#define _USE_MATH_DEFINES
+#include "../src/spatial_index.h"
+
+namespace spatial{
+
+namespace {
+
+const double EARTH_RADIUS = 6371000;
+const double DEG_TO_RAD = M_PI / 180.0;
+
+double AxisValue(const geo::Coordinates& point, int depth){
+    return depth % 2 == 0 ? point.lat : point.lng;
+}
+
+double DistanceToMeridian(const geo::Coordinates& point, double delta_lng){
+    return std::asin(std::cos(point.lat * DEG_TO_RAD) * std::abs(std::sin(delta_lng * DEG_TO_RAD))) * EARTH_RADIUS;
+}
+
+// Lower bound of the great-circle distance from point to any location lying
+// on the other side of the splitting parallel or meridian
+double DistanceToSplit(const geo::Coordinates& point, double split, int depth){
+    const double delta = std::abs(AxisValue(point, depth) - split);
+    if(depth % 2 == 0){
+        return delta * DEG_TO_RAD * EARTH_RADIUS;
+    }
+
+    // Shortest path to the other side crosses either the split meridian or the antimeridian
+    double distance = DistanceToMeridian(point, delta);
+    if(point.lng < split && point.lng < 0){
+        distance = std::min(distance, DistanceToMeridian(point, point.lng + 180.0));
+    }else if(point.lng >= split && point.lng > 0){
+        distance = std::min(distance, DistanceToMeridian(point, 180.0 - point.lng));
+    }
+    return distance;
+}
+
+bool CloserThan(const NearbyStop& left, const NearbyStop& right){
+    return left.distance < right.distance;
+}
+}
+
+bool BoundingBox::Contains(const geo::Coordinates& point) const{
+    return point.lat >= min.lat && point.lat <= max.lat
+        && point.lng >= min.lng && point.lng <= max.lng;
+}
+
+bool BoundingBox::Intersects(const BoundingBox& other) const{
+    return other.min.lat <= max.lat && other.max.lat >= min.lat
+        && other.min.lng <= max.lng && other.max.lng >= min.lng;
+}
+
+bool BoundingBox::Crosses(const geo::Coordinates& from, const geo::Coordinates& to) const{
+    // Liang-Barsky: clips the parameter range [0, 1] of the segment against every side
+    double enter = 0.0;
+    double leave = 1.0;
+    auto clip = [&enter, &leave](double direction, double distance){
+        if(direction == 0.0){
+            return distance >= 0.0;
+        }
+        const double t = distance / direction;
+        if(direction < 0.0){
+            enter = std::max(enter, t);
+        }else{
+            leave = std::min(leave, t);
+        }
+        return enter <= leave;
+    };
+
+    const double d_lat = to.lat - from.lat;
+    const double d_lng = to.lng - from.lng;
+    return clip(-d_lat, from.lat - min.lat) && clip(d_lat, max.lat - from.lat)
+        && clip(-d_lng, from.lng - min.lng) && clip(d_lng, max.lng - from.lng);
+}
+
+// ---------------- Build --------------------------
+void StopIndex::Build(std::vector<StopPtr> stops, const geo::CoordinateTable& coordinates){
+    std::vector<Node> nodes;
+    nodes.reserve(stops.size());
+    for(const auto& stop : stops){
+        nodes.push_back({stop, coordinates.Get(stop->id)});
+    }
+    BuildRange(nodes, 0, nodes.size(), 0);
+
+    nodes_.resize(nodes.size());
+    lat_.resize(nodes.size());
+    lng_.resize(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i){
+        nodes_[i] = nodes[i].stop;
+        lat_[i] = nodes[i].location.lat;
+        lng_[i] = nodes[i].location.lng;
+    }
+}
+
+void StopIndex::BuildRange(std::vector<Node>& nodes, size_t begin, size_t end, int depth){
+    if(end - begin < 2){
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(nodes.begin() + begin, nodes.begin() + middle, nodes.begin() + end,
+                     [depth](const Node& left, const Node& right){
+        return AxisValue(left.location, depth) < AxisValue(right.location, depth);
+    });
+
+    BuildRange(nodes, begin, middle, depth + 1);
+    BuildRange(nodes, middle + 1, end, depth + 1);
+}
+
+geo::Coordinates StopIndex::Location(size_t node) const{
+    return {lat_[node], lng_[node]};
+}
+
+void StopIndex::Rebase(const std::deque<Stop>& stops){
+    for(auto& node : nodes_){
+        node = &stops[node->id];
+    }
+}
+
+size_t StopIndex::Size() const{
+    return nodes_.size();
+}
+
+// ---------------- Nearest stops --------------------------
+std::vector<NearbyStop> StopIndex::FindNearest(const geo::Coordinates& point, size_t count) const{
+    std::vector<NearbyStop> heap;
+    if(count == 0){
+        return heap;
+    }
+    heap.reserve(std::min(count, nodes_.size()));
+
+    SearchNearest(0, nodes_.size(), 0, point, count, heap);
+
+    std::sort_heap(heap.begin(), heap.end(), CloserThan);
+    return heap;
+}
+
+void StopIndex::SearchNearest(size_t begin, size_t end, int depth, const geo::Coordinates& point,
+                              size_t count, std::vector<NearbyStop>& heap) const{
+    if(begin >= end){
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    StopPtr stop = nodes_[middle];
+    const geo::Coordinates location = Location(middle);
+
+    // Heap keeps the farthest of the current candidates on top
+    double distance = geo::ComputeDistance(point, location);
+    if(heap.size() < count){
+        heap.push_back({stop, distance});
+        std::push_heap(heap.begin(), heap.end(), CloserThan);
+    }else if(distance < heap.front().distance){
+        std::pop_heap(heap.begin(), heap.end(), CloserThan);
+        heap.back() = {stop, distance};
+        std::push_heap(heap.begin(), heap.end(), CloserThan);
+    }
+
+    double split = AxisValue(location, depth);
+    bool go_left = AxisValue(point, depth) < split;
+
+    if(go_left){
+        SearchNearest(begin, middle, depth + 1, point, count, heap);
+    }else{
+        SearchNearest(middle + 1, end, depth + 1, point, count, heap);
+    }
+
+    if(heap.size() == count && DistanceToSplit(point, split, depth) >= heap.front().distance){
+        return;
+    }
+
+    if(go_left){
+        SearchNearest(middle + 1, end, depth + 1, point, count, heap);
+    }else{
+        SearchNearest(begin, middle, depth + 1, point, count, heap);
+    }
+}
+
+// ---------------- Bounding box --------------------------
+std::vector<StopPtr> StopIndex::FindInside(const BoundingBox& box) const{
+    std::vector<StopPtr> result;
+    SearchInside(0, nodes_.size(), 0, box, result);
+    return result;
+}
+
+void StopIndex::SearchInside(size_t begin, size_t end, int depth, const BoundingBox& box,
+                             std::vector<StopPtr>& result) const{
+    if(begin >= end){
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    const geo::Coordinates location = Location(middle);
+
+    if(box.Contains(location)){
+        result.push_back(nodes_[middle]);
+    }
+
+    double split = AxisValue(location, depth);
+    if(AxisValue(box.min, depth) <= split){
+        SearchInside(begin, middle, depth + 1, box, result);
+    }
+    if(AxisValue(box.max, depth) >= split){
+        SearchInside(middle + 1, end, depth + 1, box, result);
+    }
+}
+}
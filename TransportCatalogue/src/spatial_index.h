@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+#include "../src/domain.h"
+#include "../src/geo.h"
+
+namespace spatial{
+using namespace entities;
+
+struct BoundingBox{
+    geo::Coordinates min; // south-west corner
+    geo::Coordinates max; // north-east corner
+
+    bool Contains(const geo::Coordinates& point) const;
+    bool Intersects(const BoundingBox& other) const;
+    // Whether the straight line between the points, in degrees, passes through the box
+    bool Crosses(const geo::Coordinates& from, const geo::Coordinates& to) const;
+};
+
+// Static 2-d tree over stop coordinates. Nodes are kept in one array, the median of
+// every range is its root, so the tree needs no child pointers and is rebuilt in full
+// whenever the stop set changes. Node coordinates are copied next to the nodes in tree order.
+class StopIndex{
+public:
+    void Build(std::vector<StopPtr> stops, const geo::CoordinateTable& coordinates);
+    // Points the index at copies of its stops, found by stop id
+    void Rebase(const std::deque<Stop>& stops);
+
+    std::vector<NearbyStop> FindNearest(const geo::Coordinates& point, size_t count) const;
+    std::vector<StopPtr> FindInside(const BoundingBox& box) const;
+
+    size_t Size() const;
+
+private:
+    struct Node{
+        StopPtr stop;
+        geo::Coordinates location;
+    };
+
+    static void BuildRange(std::vector<Node>& nodes, size_t begin, size_t end, int depth);
+    geo::Coordinates Location(size_t node) const;
+    void SearchNearest(size_t begin, size_t end, int depth, const geo::Coordinates& point,
+                       size_t count, std::vector<NearbyStop>& heap) const;
+    void SearchInside(size_t begin, size_t end, int depth, const BoundingBox& box,
+                      std::vector<StopPtr>& result) const;
+
+private:
+    std::vector<StopPtr> nodes_;
+    std::vector<double> lat_;
+    std::vector<double> lng_;
+};
+}
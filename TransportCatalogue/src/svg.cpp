@@ -1,4 +1,10 @@
 #include "../src/svg.h"
+#include "../src/memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 
 namespace svg {
 using namespace std::literals;
@@ -46,6 +52,18 @@ std::ostream& operator<<(std::ostream& out, StrokeLineJoin line_join){
     return out;
 }
 
+template <typename Owner>
+size_t PathProps<Owner>::AttrsHeapUsage() const {
+    size_t result = memory::HeapUsage(class_name_);
+    if (const auto* color = std::get_if<std::string>(&fill_color_)) {
+        result += memory::HeapUsage(*color);
+    }
+    if (const auto* color = std::get_if<std::string>(&stroke_color_)) {
+        result += memory::HeapUsage(*color);
+    }
+    return result;
+}
+
 // ---------- Circle ------------------
 
 Circle& Circle::SetCenter(Point center)  {
@@ -58,6 +76,10 @@ Circle& Circle::SetRadius(double radius)  {
     return *this;
 }
 
+size_t Circle::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Circle)) + AttrsHeapUsage();
+}
+
 void Circle::RenderObject(const RenderContext& context) const{
     auto& out = context.out;
     out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
@@ -73,6 +95,10 @@ Polyline& Polyline::AddPoint(Point point){
     return *this;
 }
 
+size_t Polyline::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Polyline)) + memory::HeapUsage(points_) + AttrsHeapUsage();
+}
+
 void Polyline::RenderObject(const RenderContext& context) const {
     auto& out = context.out;
     out << "<polyline"sv;
@@ -93,6 +119,68 @@ void Polyline::RenderObject(const RenderContext& context) const {
     out << "/>\\n"sv;
 }
 
+// ---------- Path ------------------
+
+Path& Path::AddPoint(Point point){
+    points_.push_back(point);
+    return *this;
+}
+
+Path& Path::SetPrecision(double step){
+    step_ = step;
+    return *this;
+}
+
+size_t Path::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Path)) + memory::HeapUsage(points_) + AttrsHeapUsage();
+}
+
+void Path::RenderObject(const RenderContext& context) const {
+    auto& out = context.out;
+    out << "<path d=\""sv;
+
+    // Prints the number as the stream would and returns the value a reader parses back
+    auto print_number = [&out](double value){
+        char buffer[32];
+        const int size = std::snprintf(buffer, sizeof(buffer), "%.*g", static_cast<int>(out.precision()), value);
+        out.write(buffer, size);
+        return std::strtod(buffer, nullptr);
+    };
+    // Minus sign separates numbers as well
+    auto print_pair = [&](double x, double y){
+        Point printed;
+        printed.x = print_number(x);
+        if(y >= 0){
+            out << ',';
+        }
+        printed.y = print_number(y);
+        return printed;
+    };
+    auto snap = [this](double value){
+        return step_ > 0.0 ? std::round(value / step_) * step_ : value;
+    };
+
+    if (!points_.empty()) {
+        // Moves start from the position a reader reaches by adding up the printed ones.
+        // On a grid they are snapped too, or tiny float residues would be printed
+        out << 'M';
+        Point reached = print_pair(snap(points_[0].x), snap(points_[0].y));
+
+        for (size_t i = 1; i < points_.size(); ++i) {
+            double dx = snap(snap(points_[i].x) - reached.x);
+            double dy = snap(snap(points_[i].y) - reached.y);
+            out << (i == 1 ? "l"sv : (dx < 0 ? ""sv : " "sv));
+            Point printed = print_pair(dx, dy);
+            reached.x += printed.x;
+            reached.y += printed.y;
+        }
+    }
+    out << "\""sv;
+    RenderAttrs(out);
+
+    out << "/>\\n"sv;
+}
+
 // ---------- Text ------------------
 
 Text& Text::SetPosition(Point pos){
@@ -125,14 +213,29 @@ Text& Text::SetData(std::string data){
     return *this;
 }
 
+Text& Text::SetId(std::string id){
+    id_ = std::move(id);
+    return *this;
+}
+
+size_t Text::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Text)) + memory::HeapUsage(font_family_)
+        + memory::HeapUsage(font_weight_) + memory::HeapUsage(data_) + memory::HeapUsage(id_) + AttrsHeapUsage();
+}
+
 void Text::RenderObject(const RenderContext& context) const {
     auto& out = context.out;
     out << "<text";
+    if(!id_.empty()){
+        out << " id=\""sv << id_ << "\""sv;
+    }
     RenderAttrs(out);
 
     out << " x=\""sv << pos_.x << "\" y=\""sv << pos_.y << "\" "sv;
-    out << "dx=\""sv << offset_.x << "\" " << "dy=\""sv << offset_.y << "\" "sv;
-    out << "font-size=\""sv << size_ << "\""sv;
+    out << "dx=\""sv << offset_.x << "\" " << "dy=\""sv << offset_.y << "\""sv;
+    if(size_){
+        out << " font-size=\""sv << *size_ << "\""sv;
+    }
 
     if(!font_family_.empty()){
         out << " font-family=\""sv << font_family_ << "\""sv;
@@ -144,14 +247,96 @@ void Text::RenderObject(const RenderContext& context) const {
     out << ">" << data_ << "</text>\\n"sv;
 }
 
+// ---------- Use ------------------
+
+Use& Use::SetHref(std::string id){
+    id_ = std::move(id);
+    return *this;
+}
+
+size_t Use::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Use)) + memory::HeapUsage(id_) + AttrsHeapUsage();
+}
+
+bool Use::UsesXlink() const {
+    return true;
+}
+
+// SVG 1.1 renderers resolve only xlink:href
+void Use::RenderObject(const RenderContext& context) const {
+    auto& out = context.out;
+    out << "<use xlink:href=\"#"sv << id_ << "\""sv;
+    RenderAttrs(out);
+    out << "/>\\n"sv;
+}
+
+// ---------- Style ------------------
+
+Style& Style::SetRules(std::string rules){
+    rules_ = std::move(rules);
+    return *this;
+}
+
+size_t Style::HeapUsage() const {
+    return memory::AllocationSize(sizeof(Style)) + memory::HeapUsage(rules_);
+}
+
+void Style::RenderObject(const RenderContext& context) const {
+    context.out << "<style>"sv << rules_ << "</style>\\n"sv;
+}
+
+// ---------- Definitions ------------------
+
+void Definitions::AddPtr(std::unique_ptr<Object>&& obj){
+    objects_.emplace_back(std::move(obj));
+}
+
+size_t Definitions::Size() const {
+    return objects_.size();
+}
+
+size_t Definitions::HeapUsage() const {
+    size_t result = memory::AllocationSize(sizeof(Definitions)) + memory::HeapUsage(objects_);
+    for(const auto& object : objects_){
+        result += object->HeapUsage();
+    }
+    return result;
+}
+
+void Definitions::RenderObject(const RenderContext& context) const {
+    auto& out = context.out;
+    out << "<defs>\\n"sv;
+    for(const auto& object : objects_){
+        object->Render(context.Indented());
+    }
+    context.RenderIndent();
+    out << "</defs>\\n"sv;
+}
+
 // ---------- Document ------------------
 void Document::AddPtr(std::unique_ptr<Object>&& obj){
     objects_.emplace_back(std::move(obj));
 }
 
+void Document::Clear(){
+    objects_.clear();
+}
+
+size_t Document::HeapUsage() const {
+    size_t result = memory::HeapUsage(objects_);
+    for(const auto& object : objects_){
+        result += object->HeapUsage();
+    }
+    return result;
+}
+
 void Document::Render(std::ostream& out) const {
     out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\\n"sv;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\\n"sv;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\""sv;
+    if(std::any_of(objects_.begin(), objects_.end(), [](const auto& object){ return object->UsesXlink(); })){
+        out << " xmlns:xlink=\"http://www.w3.org/1999/xlink\""sv;
+    }
+    out << " version=\"1.1\">\\n"sv;
     RenderContext ctx(out, 2, 2);
 
     for(const auto& object : objects_){
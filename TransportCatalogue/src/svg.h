@@ -143,6 +143,11 @@ public:
         line_join_ = std::move(line_join);
         return AsOwner();
     }
+    // Space separated names of <style> classes the element takes its presentation from
+    Owner& SetClass(std::string class_name) {
+        class_name_ = std::move(class_name);
+        return AsOwner();
+    }
 
 protected:
     ~PathProps() = default;
@@ -171,8 +176,13 @@ protected:
         if (line_join_) {
             out << " stroke-linejoin=\""sv << *line_join_ << "\""sv;
         }
+        if (!class_name_.empty()) {
+            out << " class=\""sv << class_name_ << "\""sv;
+        }
     }
 
+    size_t AttrsHeapUsage() const;
+
 private:
     Owner& AsOwner() {
         return static_cast<Owner&>(*this);
@@ -184,12 +194,21 @@ private:
 
     std::optional<StrokeLineCap> line_cap_;
     std::optional<StrokeLineJoin> line_join_;
+
+    std::string class_name_;
 };
 
 class Object {
 public:
     void Render(const RenderContext& context) const;
 
+    // Bytes of the object allocation and everything it owns
+    virtual size_t HeapUsage() const = 0;
+    // Refers to other elements through xlink:href, the document then declares the xlink namespace
+    virtual bool UsesXlink() const {
+        return false;
+    }
+
     virtual ~Object() = default;
 
 private:
@@ -203,6 +222,8 @@ public:
     Circle& SetCenter(Point center);
     Circle& SetRadius(double radius);
 
+    size_t HeapUsage() const override;
+
 private:
     void RenderObject(const RenderContext& context) const override;
 
@@ -214,10 +235,30 @@ class Polyline final : public Object, public PathProps<Polyline> {
 public:
     Polyline() = default;
     Polyline& AddPoint(Point point);
+
+    size_t HeapUsage() const override;
+private:
+    void RenderObject(const RenderContext& context) const override;
+
+    std::vector<Point> points_;
+};
+
+// Same line as Polyline written as a path of relative moves, which are much shorter than
+// absolute coordinates. With a precision step every point is snapped to a grid of that step
+// first, so the moves are multiples of it. Every move is measured from the position the printed
+// moves add up to, so their rounding errors don't accumulate along the path
+class Path final : public Object, public PathProps<Path> {
+public:
+    Path() = default;
+    Path& AddPoint(Point point);
+    Path& SetPrecision(double step);
+
+    size_t HeapUsage() const override;
 private:
     void RenderObject(const RenderContext& context) const override;
 
     std::vector<Point> points_;
+    double step_ = 0.0;
 };
 
 class Text final : public Object, public PathProps<Text> {
@@ -229,19 +270,53 @@ public:
     Text& SetFontFamily(std::string font_family);
     Text& SetFontWeight(std::string font_weight);
     Text& SetData(std::string data);
+    // Lets <use> elements refer to the text
+    Text& SetId(std::string id);
+
+    size_t HeapUsage() const override;
 
 private:
     void RenderObject(const RenderContext& context) const override;
 
+    std::string id_;
     Point pos_ = {0.0, 0.0};
     Point offset_ = {0.0, 0.0};
-    uint32_t size_ = 1;
+    std::optional<uint32_t> size_; // font size of the enclosing element when not set
 
     std::string font_family_;
     std::string font_weight_;
     std::string data_ = "";
 };
 
+// Draws another element again, its presentation attributes are inherited by the copy
+class Use final : public Object, public PathProps<Use> {
+public:
+    Use() = default;
+    Use& SetHref(std::string id);
+
+    size_t HeapUsage() const override;
+    bool UsesXlink() const override;
+
+private:
+    void RenderObject(const RenderContext& context) const override;
+
+    std::string id_;
+};
+
+// <style> element with CSS rules for the whole document
+class Style final : public Object {
+public:
+    Style() = default;
+    Style& SetRules(std::string rules);
+
+    size_t HeapUsage() const override;
+
+private:
+    void RenderObject(const RenderContext& context) const override;
+
+    std::string rules_;
+};
+
 class ObjectContainer {
 public:
     template <typename Obj>
@@ -260,6 +335,21 @@ class Document : public ObjectContainer{
 public:
     void AddPtr(std::unique_ptr<Object>&& obj) override;
     void Render(std::ostream& out) const;
+    void Clear();
+
+    size_t HeapUsage() const;
+};
+
+// <defs> element, its objects are drawn only through <use>
+class Definitions final : public Object, public ObjectContainer {
+public:
+    void AddPtr(std::unique_ptr<Object>&& obj) override;
+    size_t Size() const;
+
+    size_t HeapUsage() const override;
+
+private:
+    void RenderObject(const RenderContext& context) const override;
 };
 
 class Drawable{
@@ -0,0 +1,212 @@
+#include "../src/transfer_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace transfers{
+
+namespace{
+
+unsigned LowestBit(uint64_t word){
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+    unsigned bit = 0;
+    while(!(word & 1)){
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+void SetBit(uint64_t* bitmap, uint32_t bit){
+    bitmap[bit / 64] |= uint64_t{1} << (bit % 64);
+}
+
+bool TestBit(const uint64_t* bitmap, uint32_t bit){
+    return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+// Plain loops over whole words, compilers turn them into vector instructions
+void UnionInto(uint64_t* target, const uint64_t* source, size_t words){
+    for(size_t i = 0; i < words; ++i){
+        target[i] |= source[i];
+    }
+}
+
+template <typename Visitor>
+void ForEachBit(uint64_t word, size_t word_index, Visitor visitor){
+    while(word != 0){
+        visitor(static_cast<uint32_t>(word_index * 64 + LowestBit(word)));
+        word &= word - 1;
+    }
+}
+
+template <typename Visitor>
+void ForEachBit(const uint64_t* bitmap, size_t words, Visitor visitor){
+    for(size_t i = 0; i < words; ++i){
+        ForEachBit(bitmap[i], i, visitor);
+    }
+}
+
+}
+
+void TransferIndex::Build(const std::vector<std::vector<uint32_t>>& buses_by_stop, size_t bus_count){
+    const size_t stop_count = buses_by_stop.size();
+    bus_count_ = bus_count;
+    words_ = (bus_count + WORD_BITS - 1) / WORD_BITS;
+
+    stop_offsets_.assign(stop_count + 1, 0);
+    for(size_t stop = 0; stop < stop_count; ++stop){
+        stop_offsets_[stop + 1] = stop_offsets_[stop] + static_cast<uint32_t>(buses_by_stop[stop].size());
+    }
+    stop_buses_.resize(stop_offsets_.back());
+    stop_bitmap_rows_.assign(stop_count, NO_BITMAP);
+    stop_bitmaps_.clear();
+
+    for(size_t stop = 0; stop < stop_count; ++stop){
+        auto begin = stop_buses_.begin() + stop_offsets_[stop];
+        auto end = std::copy(buses_by_stop[stop].begin(), buses_by_stop[stop].end(), begin);
+        std::sort(begin, end);
+
+        // A bus id takes half a word, the bitmap pays off from two ids per word
+        if(!buses_by_stop[stop].empty() && buses_by_stop[stop].size() >= 2 * words_){
+            stop_bitmap_rows_[stop] = static_cast<uint32_t>(stop_bitmaps_.size() / words_);
+            stop_bitmaps_.resize(stop_bitmaps_.size() + words_, 0);
+            uint64_t* bitmap = stop_bitmaps_.data() + stop_bitmaps_.size() - words_;
+            for(auto it = begin; it != end; ++it){
+                SetBit(bitmap, *it);
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> TransferIndex::CommonBuses(uint32_t from_stop, uint32_t to_stop) const{
+    std::vector<uint32_t> result;
+    const uint64_t* from_bitmap = StopBitmap(from_stop);
+    const uint64_t* to_bitmap = StopBitmap(to_stop);
+
+    if(from_bitmap != nullptr && to_bitmap != nullptr){
+        for(size_t i = 0; i < words_; ++i){
+            ForEachBit(from_bitmap[i] & to_bitmap[i], i, [&result](uint32_t bus){
+                result.push_back(bus);
+            });
+        }
+    }else if(from_bitmap != nullptr || to_bitmap != nullptr){
+        // Ids of the sparse stop looked up in the bitmap of the other one
+        const uint64_t* bitmap = from_bitmap != nullptr ? from_bitmap : to_bitmap;
+        const uint32_t sparse_stop = from_bitmap != nullptr ? to_stop : from_stop;
+        std::copy_if(StopBusesBegin(sparse_stop), StopBusesEnd(sparse_stop), std::back_inserter(result),
+                     [bitmap](uint32_t bus){
+            return TestBit(bitmap, bus);
+        });
+    }else{
+        std::set_intersection(StopBusesBegin(from_stop), StopBusesEnd(from_stop),
+                              StopBusesBegin(to_stop), StopBusesEnd(to_stop), std::back_inserter(result));
+    }
+    return result;
+}
+
+size_t TransferIndex::HeapUsage() const{
+    return memory::HeapUsage(stop_offsets_) + memory::HeapUsage(stop_buses_)
+         + memory::HeapUsage(stop_bitmap_rows_) + memory::HeapUsage(stop_bitmaps_);
+}
+
+const uint32_t* TransferIndex::StopBusesBegin(uint32_t stop) const{
+    return stop_buses_.data() + stop_offsets_[stop];
+}
+
+const uint32_t* TransferIndex::StopBusesEnd(uint32_t stop) const{
+    return stop_buses_.data() + stop_offsets_[stop + 1];
+}
+
+const uint64_t* TransferIndex::StopBitmap(uint32_t stop) const{
+    const uint32_t row = stop_bitmap_rows_[stop];
+    return row == NO_BITMAP ? nullptr : stop_bitmaps_.data() + static_cast<size_t>(row) * words_;
+}
+
+void TransferMatrix::Build(const TransferIndex& stops, unsigned thread_count){
+    const size_t stop_count = stops.stop_bitmap_rows_.size();
+    const size_t bus_count = stops.bus_count_;
+    words_ = stops.words_;
+
+    // Stops of bus i are bus_stops[bus_offsets[i] .. bus_offsets[i + 1])
+    std::vector<uint32_t> bus_offsets(bus_count + 1, 0);
+    for(uint32_t bus : stops.stop_buses_){
+        ++bus_offsets[bus + 1];
+    }
+    for(size_t bus = 1; bus < bus_offsets.size(); ++bus){
+        bus_offsets[bus] += bus_offsets[bus - 1];
+    }
+    std::vector<uint32_t> bus_stops(bus_offsets.back());
+    std::vector<uint32_t> filled(bus_offsets.begin(), bus_offsets.end() - 1);
+    for(size_t stop = 0; stop < stop_count; ++stop){
+        for(uint32_t i = stops.stop_offsets_[stop]; i < stops.stop_offsets_[stop + 1]; ++i){
+            bus_stops[filled[stops.stop_buses_[i]]++] = static_cast<uint32_t>(stop);
+        }
+    }
+
+    // Every bus fills only its own row
+    rows_.assign(bus_count * words_, 0);
+    parallel::ForEachIndex(bus_count, thread_count, [&](size_t bus){
+        uint64_t* row = rows_.data() + bus * words_;
+        for(uint32_t i = bus_offsets[bus]; i < bus_offsets[bus + 1]; ++i){
+            const uint32_t stop = bus_stops[i];
+            if(const uint64_t* bitmap = stops.StopBitmap(stop)){
+                UnionInto(row, bitmap, words_);
+                continue;
+            }
+            for(const uint32_t* other = stops.StopBusesBegin(stop); other != stops.StopBusesEnd(stop); ++other){
+                SetBit(row, *other);
+            }
+        }
+    });
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> TransferMatrix::ReachableBuses(const TransferIndex& stops, uint32_t stop,
+                                                                          size_t max_transfers) const{
+    std::vector<std::pair<uint32_t, uint32_t>> result;
+    std::vector<uint64_t> reached(words_, 0);
+    for(const uint32_t* bus = stops.StopBusesBegin(stop); bus != stops.StopBusesEnd(stop); ++bus){
+        SetBit(reached.data(), *bus);
+        result.emplace_back(*bus, 0);
+    }
+
+    // Buses first reached with the previous transfer, the next level is the union of their rows
+    std::vector<uint64_t> frontier = reached;
+    std::vector<uint64_t> next(words_);
+    for(size_t transfers = 1; transfers <= max_transfers; ++transfers){
+        std::fill(next.begin(), next.end(), 0);
+        ForEachBit(frontier.data(), words_, [&](uint32_t bus){
+            UnionInto(next.data(), Row(bus), words_);
+        });
+
+        bool found = false;
+        for(size_t i = 0; i < words_; ++i){
+            next[i] &= ~reached[i];
+            reached[i] |= next[i];
+            found |= next[i] != 0;
+        }
+        if(!found){
+            break;
+        }
+        ForEachBit(next.data(), words_, [&](uint32_t bus){
+            result.emplace_back(bus, static_cast<uint32_t>(transfers));
+        });
+        frontier.swap(next);
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t TransferMatrix::HeapUsage() const{
+    return memory::HeapUsage(rows_);
+}
+
+const uint64_t* TransferMatrix::Row(uint32_t bus) const{
+    return rows_.data() + static_cast<size_t>(bus) * words_;
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../src/memory_usage.h"
+#include "../src/parallel.h"
+
+namespace transfers{
+
+// Set queries over which buses serve which stops, with buses as bits of a bus id bitmap.
+// A stop row is kept like a roaring container: sorted bus ids, plus a bitmap once one in 32 of
+// all buses stop there and the bitmap is no larger than the ids. Row i of the transfer
+// matrix is a bitmap of the buses that share a stop with bus i, a reachability search unions
+// whole rows of it per transfer. The matrix takes bus_count^2 / 8 bytes, so it is a separate
+// TransferMatrix built from the stop rows on demand.
+class TransferIndex{
+public:
+    // buses_by_stop[i] holds the ids of the buses at stop i, without repeats, in any order
+    void Build(const std::vector<std::vector<uint32_t>>& buses_by_stop, size_t bus_count);
+
+    // Ids of the buses serving both stops, ascending
+    std::vector<uint32_t> CommonBuses(uint32_t from_stop, uint32_t to_stop) const;
+
+    size_t HeapUsage() const;
+
+private:
+    friend class TransferMatrix;
+
+    static constexpr uint32_t NO_BITMAP = UINT32_MAX;
+    static constexpr size_t WORD_BITS = 64;
+
+    const uint32_t* StopBusesBegin(uint32_t stop) const;
+    const uint32_t* StopBusesEnd(uint32_t stop) const;
+    // nullptr for a stop stored as ids only
+    const uint64_t* StopBitmap(uint32_t stop) const;
+
+private:
+    size_t bus_count_ = 0;
+    size_t words_ = 0; // per bitmap
+
+    // Buses of stop i are stop_buses_[stop_offsets_[i] .. stop_offsets_[i + 1]), sorted
+    std::vector<uint32_t> stop_offsets_;
+    std::vector<uint32_t> stop_buses_;
+    std::vector<uint32_t> stop_bitmap_rows_; // by stop, NO_BITMAP for sparse stops
+    std::vector<uint64_t> stop_bitmaps_;
+};
+
+class TransferMatrix{
+public:
+    void Build(const TransferIndex& stops, unsigned thread_count = parallel::DefaultThreadCount());
+
+    // (bus id, fewest transfers) for every bus that can be boarded from the stop with at most
+    // max_transfers changes, ascending by id. Buses at the stop itself need no transfer.
+    // stops must be the rows the matrix was built from
+    std::vector<std::pair<uint32_t, uint32_t>> ReachableBuses(const TransferIndex& stops, uint32_t stop,
+                                                              size_t max_transfers) const;
+
+    size_t HeapUsage() const;
+
+private:
+    const uint64_t* Row(uint32_t bus) const;
+
+private:
+    size_t words_ = 0;
+    std::vector<uint64_t> rows_; // bus_count rows of words_
+};
+
+}
@@ -2,8 +2,109 @@
 
 namespace transport_catalogue{
 using namespace entities;
+using namespace std::string_literals;
+
+namespace {
+
+// Shard of a directed stop pair, cheaper than the table hash
+size_t SegmentShard(StopPtr from, StopPtr to, unsigned shard_count){
+    return (static_cast<size_t>(from->id) * 0x9E3779B1u + to->id) % shard_count;
+}
+
+uint64_t SegmentKey(StopPtr from, StopPtr to){
+    return (static_cast<uint64_t>(from->id) << 32) | to->id;
+}
+
+}
+
+TransportCatalogue::TransportCatalogue(const TransportCatalogue& other)
+    : buses_(other.buses_)
+    , stops_(other.stops_)
+    , stop_coordinates_(other.stop_coordinates_)
+    , stop_trig_(other.stop_trig_)
+    , indexed_bus_count_(other.indexed_bus_count_)
+    , trip_offsets_(other.trip_offsets_)
+    , trip_road_lengths_(other.trip_road_lengths_)
+    , trip_geo_lengths_(other.trip_geo_lengths_)
+    , trip_stop_positions_(other.trip_stop_positions_)
+    , stop_index_(other.stop_index_)
+    , route_bounds_(other.route_bounds_)
+    , bus_bounds_(other.bus_bounds_)
+    , frozen_(other.frozen_)
+    , frozen_index_(other.frozen_index_)
+    , version_(other.version_)
+    , index_threads_(other.index_threads_){
+
+    // Ids are positions in the deques
+    auto stop_copy = [this](StopPtr stop) -> StopPtr {
+        return &stops_[stop->id];
+    };
+    auto bus_copy = [this](BusPtr bus) -> BusPtr {
+        return &buses_[bus->id];
+    };
+    auto segment_copy = [&stop_copy](const std::pair<StopPtr, StopPtr>& segment){
+        return std::make_pair(stop_copy(segment.first), stop_copy(segment.second));
+    };
+
+    for(auto& bus : buses_){
+        for(auto& stop : bus.stops){
+            stop = stop_copy(stop);
+        }
+    }
+
+    // Name keys must view the copied names
+    if(frozen_){
+        BuildFrozenNames();
+    }else{
+        for(auto& stop : stops_){
+            stop_access_.emplace(stop.name, &stop);
+        }
+        for(auto& bus : buses_){
+            bus_access_.emplace(bus.name, &bus);
+        }
+    }
+
+    for(const auto& [stop, buses] : other.bus_by_stop_){
+        auto& copied_buses = bus_by_stop_[stop_copy(stop)];
+        for(const auto& bus : buses){
+            copied_buses.insert(bus_copy(bus));
+        }
+    }
+    for(const auto& [bus, stops] : other.stop_by_bus_){
+        auto& copied_stops = stop_by_bus_[bus_copy(bus)];
+        for(const auto& stop : stops){
+            copied_stops.insert(stop_copy(stop));
+        }
+    }
+
+    distance_between_stops_.reserve(other.distance_between_stops_.size());
+    for(const auto& [segment, distance] : other.distance_between_stops_){
+        distance_between_stops_.emplace(segment_copy(segment), distance);
+    }
+    geo_distance_between_stops_.reserve(other.geo_distance_between_stops_.size());
+    for(const auto& [segment, length] : other.geo_distance_between_stops_){
+        geo_distance_between_stops_.emplace(segment_copy(segment), length);
+    }
+    for(const auto& [from, to, distance] : other.pending_distances_){
+        pending_distances_.push_back({stop_copy(from), stop_copy(to), distance});
+    }
+
+    stop_index_.Rebase(stops_);
+    route_index_.reserve(other.route_index_.size());
+    for(const auto& [bus, index] : other.route_index_){
+        route_index_.emplace(bus_copy(bus), index);
+    }
+}
+
+TransportCatalogue& TransportCatalogue::operator=(const TransportCatalogue& other){
+    if(this != &other){
+        *this = TransportCatalogue(other);
+    }
+    return *this;
+}
 
 void TransportCatalogue::AddBus(const std::string& bus, std::vector<std::string> stops, bool roundtrip) {
+    CheckWritable();
     std::vector<StopPtr> stop_pointers;
 
     for(const std::string& stop : stops){
@@ -14,40 +115,53 @@ void TransportCatalogue::AddBus(const std::string& bus, std::vector<std::string>
     }
 
     // Creates bus in deque
-    Bus new_bus = {bus, stop_pointers, roundtrip};
+    Bus new_bus = {bus, stop_pointers, roundtrip, static_cast<uint32_t>(buses_.size())};
 
     auto& bus_reference = buses_.emplace_back(new_bus);
 
-    // Adding buses to stops
-    for(const auto& stop : stop_pointers){
-        bus_by_stop_[stop_access_[stop->name]].emplace(&bus_reference);
-        bus_by_stop_.at(stop_access_[stop->name]).size();
-    }
-
     // Creates bus access
     bus_access_.emplace(bus_reference.name, &bus_reference);
+    ++version_;
 }
 
 void TransportCatalogue::AddStop(const std::string& stop){
-    Stop new_stop = {stop, {}};
+    CheckWritable();
+    Stop new_stop = {stop, static_cast<uint32_t>(stops_.size())};
     auto& stop_reference = stops_.emplace_back(new_stop);
     stop_access_.emplace(stop_reference.name, &stop_reference);
+    stop_coordinates_.Set(stop_reference.id, {0.0, 0.0});
+    stop_trig_.Set(stop_reference.id, stop_coordinates_.Get(stop_reference.id));
+    ++version_;
 }
 
 void TransportCatalogue::AddStop(const std::string& stop, const geo::Coordinates& coordinates){
+    CheckWritable();
     // Check if stop is new
     if(stop_access_.find(stop) == stop_access_.end()){
-        Stop new_stop = {stop, coordinates};
+        Stop new_stop = {stop, static_cast<uint32_t>(stops_.size())};
 
         auto& stop_reference = stops_.emplace_back(std::move(new_stop));
         stop_access_.emplace(stop_reference.name, &stop_reference);
+        stop_coordinates_.Set(stop_reference.id, coordinates);
+        stop_trig_.Set(stop_reference.id, stop_coordinates_.Get(stop_reference.id));
     }else{
-        stop_access_[stop]->location = coordinates;
+        Stop* stop_reference = stop_access_[stop];
+        stop_coordinates_.Set(stop_reference->id, coordinates);
+        stop_trig_.Set(stop_reference->id, stop_coordinates_.Get(stop_reference->id));
+
+        // Stop was moved, cached lengths of its segments are stale
+        if(bus_by_stop_.find(stop_reference) != bus_by_stop_.end()){
+            for(const auto& bus : bus_by_stop_.at(stop_reference)){
+                RefreshSegmentLengths(*bus);
+            }
+        }
     }
+    ++version_;
 }
 
 void TransportCatalogue::SetDistanceBetweenStops(const std::string& stop,
                                                  const std::vector<std::pair<std::string, int>>& distance_to_stops){
+    CheckWritable();
     Stop* main_stop = stop_access_.at(stop);
 
     for(const auto& [stop_name, distance] : distance_to_stops){
@@ -56,9 +170,284 @@ void TransportCatalogue::SetDistanceBetweenStops(const std::string& stop,
         }
         Stop* stop_from_list = stop_access_.at(stop_name);
 
-        distance_between_stops_[std::make_pair(main_stop, stop_from_list)] = distance;
-        distance_between_stops_.emplace(std::make_pair(stop_from_list, main_stop), distance);
+        pending_distances_.push_back({main_stop, stop_from_list, distance});
+    }
+    ++version_;
+}
+
+void TransportCatalogue::RefreshSegmentLengths(const Bus& bus){
+    std::vector<uint32_t> from;
+    std::vector<uint32_t> to;
+
+    for(size_t i = 1; i < bus.stops.size(); ++i){
+        from.push_back(bus.stops[i - 1]->id);
+        to.push_back(bus.stops[i]->id);
+    }
+
+    std::vector<double> lengths(from.size());
+    geo::ComputeDistances(stop_trig_, from.data(), to.data(), lengths.data(), lengths.size());
+
+    for(size_t i = 0; i < lengths.size(); ++i){
+        const StopPtr stop1 = bus.stops[i];
+        const StopPtr stop2 = bus.stops[i + 1];
+        geo_distance_between_stops_[std::make_pair(stop1, stop2)] = lengths[i];
+        geo_distance_between_stops_[std::make_pair(stop2, stop1)] = lengths[i];
+    }
+}
+
+void TransportCatalogue::IndexBusStops(size_t first_bus, unsigned thread_count){
+    const size_t bus_count = buses_.size() - first_bus;
+
+    // Every thread sorts the stops of its buses by shard...
+    std::vector<std::vector<std::vector<std::pair<StopPtr, BusPtr>>>> entries(
+        thread_count, std::vector<std::vector<std::pair<StopPtr, BusPtr>>>(thread_count));
+
+    parallel::RunTasks(thread_count, [&](unsigned chunk){
+        size_t begin = first_bus + bus_count * chunk / thread_count;
+        size_t end = first_bus + bus_count * (chunk + 1) / thread_count;
+        for(size_t i = begin; i < end; ++i){
+            const Bus& bus = buses_[i];
+            for(const auto& stop : bus.stops){
+                entries[chunk][stop->id % thread_count].emplace_back(stop, &bus);
+            }
+        }
+    });
+
+    // ...then owns one shard and builds that part of the index
+    std::vector<std::unordered_map<StopPtr, std::unordered_set<BusPtr>>> shards(thread_count);
+
+    parallel::RunTasks(thread_count, [&](unsigned shard){
+        for(unsigned chunk = 0; chunk < thread_count; ++chunk){
+            for(const auto& [stop, bus] : entries[chunk][shard]){
+                shards[shard][stop].insert(bus);
+            }
+        }
+    });
+
+    size_t stop_count = bus_by_stop_.size();
+    for(const auto& shard : shards){
+        stop_count += shard.size();
+    }
+    bus_by_stop_.reserve(stop_count);
+
+    for(auto& shard : shards){
+        bus_by_stop_.merge(shard);
+        // Stops that already had buses stay behind in the shard
+        for(auto& [stop, buses] : shard){
+            bus_by_stop_.at(stop).merge(buses);
+        }
+    }
+}
+
+void TransportCatalogue::IndexRoadDistances(unsigned thread_count){
+    struct Entry{
+        std::pair<StopPtr, StopPtr> segment;
+        int distance;
+        bool forward;
+    };
+
+    // The given direction always overwrites, the reverse one is only a default for a pair without its own distance
+    std::vector<std::vector<std::vector<Entry>>> entries(thread_count, std::vector<std::vector<Entry>>(thread_count));
+
+    parallel::RunTasks(thread_count, [&](unsigned chunk){
+        size_t begin = pending_distances_.size() * chunk / thread_count;
+        size_t end = pending_distances_.size() * (chunk + 1) / thread_count;
+        for(size_t i = begin; i < end; ++i){
+            const auto& [from, to, distance] = pending_distances_[i];
+            entries[chunk][SegmentShard(from, to, thread_count)].push_back({{from, to}, distance, true});
+            entries[chunk][SegmentShard(to, from, thread_count)].push_back({{to, from}, distance, false});
+        }
+    });
+
+    using DistanceTable = decltype(distance_between_stops_);
+    std::vector<DistanceTable> forward_shards(thread_count);
+    std::vector<DistanceTable> reverse_shards(thread_count);
+
+    // Chunks are visited in input order, so the last given distance wins as with serial inserts
+    parallel::RunTasks(thread_count, [&](unsigned shard){
+        for(unsigned chunk = 0; chunk < thread_count; ++chunk){
+            for(const auto& [segment, distance, forward] : entries[chunk][shard]){
+                if(forward){
+                    forward_shards[shard][segment] = distance;
+                }else{
+                    reverse_shards[shard].emplace(segment, distance);
+                }
+            }
+        }
+    });
+
+    size_t pair_count = distance_between_stops_.size();
+    for(unsigned shard = 0; shard < thread_count; ++shard){
+        pair_count += forward_shards[shard].size() + reverse_shards[shard].size();
+    }
+    distance_between_stops_.reserve(pair_count);
+
+    for(unsigned shard = 0; shard < thread_count; ++shard){
+        distance_between_stops_.merge(forward_shards[shard]);
+        for(const auto& [segment, distance] : forward_shards[shard]){
+            distance_between_stops_[segment] = distance;
+        }
+        // Reverse defaults already known are left behind
+        distance_between_stops_.merge(reverse_shards[shard]);
+    }
+
+    pending_distances_.clear();
+}
+
+void TransportCatalogue::IndexSegmentLengths(size_t first_bus, unsigned thread_count){
+    const size_t bus_count = buses_.size() - first_bus;
+    std::vector<std::vector<std::vector<std::pair<std::pair<StopPtr, StopPtr>, double>>>> entries(
+        thread_count, std::vector<std::vector<std::pair<std::pair<StopPtr, StopPtr>, double>>>(thread_count));
+
+    // Lengths of a thread's segments are computed in one batch
+    parallel::RunTasks(thread_count, [&](unsigned chunk){
+        size_t begin = first_bus + bus_count * chunk / thread_count;
+        size_t end = first_bus + bus_count * (chunk + 1) / thread_count;
+
+        std::vector<uint32_t> from;
+        std::vector<uint32_t> to;
+        std::vector<std::pair<StopPtr, StopPtr>> segments;
+        for(size_t i = begin; i < end; ++i){
+            const Bus& bus = buses_[i];
+            for(size_t j = 1; j < bus.stops.size(); ++j){
+                auto segment = std::make_pair(bus.stops[j - 1], bus.stops[j]);
+                if(geo_distance_between_stops_.count(segment) > 0){
+                    continue;
+                }
+                from.push_back(segment.first->id);
+                to.push_back(segment.second->id);
+                segments.push_back(segment);
+            }
+        }
+
+        std::vector<double> lengths(segments.size());
+        geo::ComputeDistances(stop_trig_, from.data(), to.data(), lengths.data(), lengths.size());
+
+        for(size_t i = 0; i < segments.size(); ++i){
+            const auto& [stop1, stop2] = segments[i];
+            entries[chunk][SegmentShard(stop1, stop2, thread_count)].emplace_back(segments[i], lengths[i]);
+            entries[chunk][SegmentShard(stop2, stop1, thread_count)].emplace_back(std::make_pair(stop2, stop1), lengths[i]);
+        }
+    });
+
+    std::vector<decltype(geo_distance_between_stops_)> shards(thread_count);
+
+    parallel::RunTasks(thread_count, [&](unsigned shard){
+        for(unsigned chunk = 0; chunk < thread_count; ++chunk){
+            for(const auto& [segment, length] : entries[chunk][shard]){
+                shards[shard].emplace(segment, length);
+            }
+        }
+    });
+
+    size_t segment_count = geo_distance_between_stops_.size();
+    for(const auto& shard : shards){
+        segment_count += shard.size();
+    }
+    geo_distance_between_stops_.reserve(segment_count);
+
+    for(auto& shard : shards){
+        geo_distance_between_stops_.merge(shard);
+    }
+}
+
+void TransportCatalogue::IndexTrips(unsigned thread_count){
+    trip_offsets_.assign(buses_.size() + 1, 0);
+    for(const auto& bus : buses_){
+        trip_offsets_[bus.id + 1] = trip_offsets_[bus.id] + RouteStopCount(bus);
+    }
+    trip_road_lengths_.resize(trip_offsets_.back());
+    trip_geo_lengths_.resize(trip_offsets_.back());
+    trip_stop_positions_.resize(trip_offsets_.back());
+
+    // Every bus writes only its own part of the arrays
+    parallel::RunTasks(thread_count, [&](unsigned chunk){
+        const size_t begin = buses_.size() * chunk / thread_count;
+        const size_t end = buses_.size() * (chunk + 1) / thread_count;
+
+        for(size_t i = begin; i < end; ++i){
+            const Bus& bus = buses_[i];
+            const size_t offset = trip_offsets_[i];
+            const size_t stop_count = RouteStopCount(bus);
+
+            int road_length = 0;
+            double geo_length = 0;
+            for(size_t position = 0; position < stop_count; ++position){
+                const StopPtr stop = RouteStop(bus, position);
+                if(position > 0){
+                    const auto segment = std::make_pair(RouteStop(bus, position - 1), stop);
+                    auto road = distance_between_stops_.find(segment);
+                    road_length = road_length < 0 || road == distance_between_stops_.end() ? -1 : road_length + road->second;
+                    geo_length += geo_distance_between_stops_.at(segment);
+                }
+                trip_road_lengths_[offset + position] = road_length;
+                trip_geo_lengths_[offset + position] = geo_length;
+                trip_stop_positions_[offset + position] = {stop->id, static_cast<uint32_t>(position)};
+            }
+            std::sort(trip_stop_positions_.begin() + offset, trip_stop_positions_.begin() + offset + stop_count);
+        }
+    });
+}
+
+void TransportCatalogue::BuildIndexes(unsigned thread_count){
+    thread_count = std::max(1u, thread_count);
+    index_threads_ = thread_count;
+    // A frozen catalogue has nothing left to index
+    if(frozen_){
+        return;
+    }
+
+    IndexBusStops(indexed_bus_count_, thread_count);
+    // Buses of the stops changed without a version bump
+    transfer_cache_.stops.reset();
+    transfer_cache_.matrix.reset();
+    IndexRoadDistances(thread_count);
+    IndexSegmentLengths(indexed_bus_count_, thread_count);
+    indexed_bus_count_ = buses_.size();
+    IndexTrips(thread_count);
+
+    std::vector<StopPtr> stop_pointers;
+    stop_pointers.reserve(stops_.size());
+    for(const auto& stop : stops_){
+        stop_pointers.push_back(&stop);
+    }
+    stop_index_.Build(std::move(stop_pointers), stop_coordinates_);
+
+    // Routes are drawn in name order, every route keeps its color in partial renders too
+    std::vector<BusRouteRenderInfo> routes = GetRenderData();
+    route_index_.clear();
+    route_index_.reserve(routes.size());
+    for(const auto& route : routes){
+        route_index_.emplace(bus_access_.at(route.name), route.route_index);
+    }
 
+    route_bounds_ = {};
+    bool first_stop = true;
+    for(const auto& [stop, buses] : bus_by_stop_){
+        const geo::Coordinates location = stop_coordinates_.Get(stop->id);
+        if(first_stop){
+            route_bounds_ = {location, location};
+            first_stop = false;
+        }
+        route_bounds_.min.lat = std::min(route_bounds_.min.lat, location.lat);
+        route_bounds_.min.lng = std::min(route_bounds_.min.lng, location.lng);
+        route_bounds_.max.lat = std::max(route_bounds_.max.lat, location.lat);
+        route_bounds_.max.lng = std::max(route_bounds_.max.lng, location.lng);
+    }
+
+    bus_bounds_.assign(buses_.size(), {});
+    for(const auto& bus : buses_){
+        spatial::BoundingBox& bounds = bus_bounds_[bus.id];
+        for(size_t i = 0; i < bus.stops.size(); ++i){
+            const geo::Coordinates location = stop_coordinates_.Get(bus.stops[i]->id);
+            if(i == 0){
+                bounds = {location, location};
+            }
+            bounds.min.lat = std::min(bounds.min.lat, location.lat);
+            bounds.min.lng = std::min(bounds.min.lng, location.lng);
+            bounds.max.lat = std::max(bounds.max.lat, location.lat);
+            bounds.max.lng = std::max(bounds.max.lng, location.lng);
+        }
     }
 }
 
@@ -74,65 +463,598 @@ std::vector<BusRouteRenderInfo> TransportCatalogue::GetRenderData()const{
         return left.name < right.name;
     });
 
+    for(size_t i = 0; i < route_info.size(); ++i){
+        route_info[i].route_index = i;
+    }
     return route_info;
 }
 
+ViewportRenderInfo TransportCatalogue::GetRenderData(const spatial::BoundingBox& box)const{
+    ViewportRenderInfo result;
+
+    // Only stops that are part of a route are drawn
+    for(const auto& stop : stop_index_.FindInside(box)){
+        bool on_route = false;
+        ForEachBusAt(stop, [&on_route](BusPtr){
+            on_route = true;
+        });
+        if(on_route){
+            result.stops.push_back(stop);
+        }
+    }
+
+    // A route is drawn when its line passes through the box, its stops may all be outside
+    for(size_t id = 0; id < bus_bounds_.size(); ++id){
+        const Bus& bus = buses_[id];
+        if(bus.stops.empty() || !box.Intersects(bus_bounds_[id])){
+            continue;
+        }
+        bool visible = box.Contains(stop_coordinates_.Get(bus.stops.front()->id));
+        for(size_t i = 1; i < bus.stops.size() && !visible; ++i){
+            visible = box.Crosses(stop_coordinates_.Get(bus.stops[i - 1]->id), stop_coordinates_.Get(bus.stops[i]->id));
+        }
+        if(visible){
+            result.routes.push_back({bus.name, bus.stops, bus.is_circular, RouteIndex(&bus)});
+        }
+    }
+
+    std::sort(result.routes.begin(), result.routes.end(),[](const auto& left, const auto& right){
+        return left.route_index < right.route_index;
+    });
+
+    return result;
+}
+
+spatial::BoundingBox TransportCatalogue::GetRouteBounds()const{
+    return route_bounds_;
+}
+
+const geo::CoordinateTable& TransportCatalogue::GetStopCoordinates()const{
+    return stop_coordinates_;
+}
+
+uint64_t TransportCatalogue::GetVersion()const{
+    return version_;
+}
+
+const std::deque<Stop>& TransportCatalogue::GetStops()const{
+    return stops_;
+}
+
+const std::deque<Bus>& TransportCatalogue::GetBuses()const{
+    return buses_;
+}
+
 std::vector<StopPtr> TransportCatalogue::FindBusRoute(const std::string& bus) const {
-      return bus_access_.at(bus)->stops;
+    BusPtr route = LookupBus(bus);
+    if(route == nullptr){
+        throw std::out_of_range("Unknown bus "s + bus);
+    }
+
+    std::vector<StopPtr> stops;
+    stops.reserve(RouteStopCount(*route));
+    for(size_t i = 0; i < RouteStopCount(*route); ++i){
+        stops.push_back(RouteStop(*route, i));
+    }
+    return stops;
 }
 
 StopPtr TransportCatalogue::FindStop(const std::string& bus_stop) const {
-    return stop_access_.at(bus_stop);
+    StopPtr stop = LookupStop(bus_stop);
+    if(stop == nullptr){
+        throw std::out_of_range("Unknown stop "s + bus_stop);
+    }
+    return stop;
 }
 
 StopBusList TransportCatalogue::StopInformation(const std::string& stop) const {
     StopBusList result = {stop, {}, {}};
     // Stop doesn't exist
-    if(stop_access_.find(stop) == stop_access_.end()){
+    const StopPtr stop_ptr = LookupStop(stop);
+    if(stop_ptr == nullptr){
         return result;
     }
     result.buses_exist = true;
 
-    // Stop exist's without a bus
-    const auto stop_ptr = stop_access_.at(stop);
-    if(bus_by_stop_.find(stop_ptr) == bus_by_stop_.end()){
-        return result;
-    }
-
-    for(const auto& bus : bus_by_stop_.at(stop_access_.at(stop))){
-        result.bus_list.emplace(bus->name) ;
-    }
+    ForEachBusAt(stop_ptr, [&result](BusPtr bus){
+        result.bus_list.emplace(bus->name);
+    });
 
     return result;
 }
 
 BusRoute TransportCatalogue::RouteInformation(const std::string& bus) const {
-
-    if(bus_access_.find(bus) == bus_access_.end()){
+    const BusPtr route = LookupBus(bus);
+    if(route == nullptr){
         return {bus, 0, 0, 0, 0};
     }
-    int stop_count = bus_access_.at(bus)->stops.size();
+    int stop_count = RouteStopCount(*route);
 
+    // The way back passes the same stops
     std::set<std::string_view> unique_stops;
-    for(auto& stop : bus_access_.at(bus)->stops){
+    for(auto& stop : route->stops){
         unique_stops.emplace(stop->name);
     }
 
     int route_length = 0;
     double route_curvature = 0;
+    if(stop_count > 0){
+        route_length = TripRoadLength(route, 0, stop_count - 1);
+        route_curvature = TripGeoLength(route, 0, stop_count - 1);
+    }
 
-    for(int i = 0; i < stop_count - 1; ++i){
-        StopPtr stop1 = stop_access_.at(bus_access_.at(bus)->stops[i]->name);
-        StopPtr stop2 = stop_access_.at(bus_access_.at(bus)->stops[i + 1]->name);
+    route_curvature = route_length/route_curvature;
+    return {bus, stop_count, static_cast<int>(unique_stops.size()), route_length, route_curvature};
+}
 
-        route_length += distance_between_stops_.at(std::make_pair(stop1, stop2));
+RouteSegment TransportCatalogue::SegmentInformation(const std::string& bus, size_t from, size_t to) const {
+    const BusPtr route = LookupBus(bus);
+    if(route == nullptr){
+        return {};
+    }
+    return TripSegment(route, from, to);
+}
 
-        geo::Coordinates location1 = stop1->location;
-        geo::Coordinates location2 = stop2->location;
-        route_curvature += geo::ComputeDistance(location1, location2);
+RouteSegment TransportCatalogue::SegmentInformation(const std::string& bus, const std::string& from,
+                                                    const std::string& to) const {
+    const BusPtr route = LookupBus(bus);
+    const StopPtr from_stop = LookupStop(from);
+    const StopPtr to_stop = LookupStop(to);
+    if(route == nullptr || from_stop == nullptr || to_stop == nullptr){
+        return {};
     }
 
-    route_curvature = route_length/route_curvature;
-    return {bus, stop_count, static_cast<int>(unique_stops.size()), route_length, route_curvature};
+    const std::optional<size_t> from_position = FindTripPosition(route, from_stop->id, 0);
+    if(!from_position){
+        return {};
+    }
+    const std::optional<size_t> to_position = FindTripPosition(route, to_stop->id, *from_position);
+    if(!to_position){
+        return {};
+    }
+    return TripSegment(route, *from_position, *to_position);
+}
+
+std::vector<NearbyStop> TransportCatalogue::FindNearestStops(const geo::Coordinates& point, size_t count) const {
+    return stop_index_.FindNearest(point, count);
+}
+
+AreaObjectList TransportCatalogue::AreaInformation(const spatial::BoundingBox& box) const {
+    AreaObjectList result;
+
+    for(const auto& stop : stop_index_.FindInside(box)){
+        result.stops.emplace(stop->name);
+
+        // Bus is in the area if at least one of its stops is
+        ForEachBusAt(stop, [&result](BusPtr bus){
+            result.buses.emplace(bus->name);
+        });
+    }
+    return result;
+}
+
+NameSuggestions TransportCatalogue::FindByPrefix(std::string_view name_prefix, size_t count) const {
+    if(frozen_){
+        return {frozen_index_.stop_names.Find(name_prefix, count), frozen_index_.bus_names.Find(name_prefix, count)};
+    }
+
+    prefix::PrefixIndex stop_names;
+    stop_names.Build(RankedStopNames());
+    prefix::PrefixIndex bus_names;
+    bus_names.Build(RankedBusNames());
+    return {stop_names.Find(name_prefix, count), bus_names.Find(name_prefix, count)};
+}
+
+CommonBusList TransportCatalogue::CommonBuses(const std::string& from, const std::string& to) const {
+    CommonBusList result;
+    const StopPtr from_stop = LookupStop(from);
+    const StopPtr to_stop = LookupStop(to);
+    if(from_stop == nullptr || to_stop == nullptr){
+        return result;
+    }
+    result.stops_exist = true;
+
+    if(frozen_){
+        for(uint32_t bus : frozen_index_.transfers.CommonBuses(from_stop->id, to_stop->id)){
+            result.buses.emplace(buses_[bus].name);
+        }
+        return result;
+    }
+
+    auto from_buses = bus_by_stop_.find(from_stop);
+    auto to_buses = bus_by_stop_.find(to_stop);
+    if(from_buses == bus_by_stop_.end() || to_buses == bus_by_stop_.end()){
+        return result;
+    }
+    for(BusPtr bus : from_buses->second){
+        if(to_buses->second.count(bus)){
+            result.buses.emplace(bus->name);
+        }
+    }
+    return result;
+}
+
+TransferReach TransportCatalogue::ReachableBuses(const std::string& stop, size_t max_transfers) const {
+    TransferReach result;
+    const StopPtr stop_ptr = LookupStop(stop);
+    if(stop_ptr == nullptr){
+        return result;
+    }
+    result.stop_exists = true;
+
+    std::shared_ptr<const transfers::TransferIndex> stop_rows;
+    const auto matrix = BusTransfers(stop_rows);
+    const transfers::TransferIndex& stops = stop_rows != nullptr ? *stop_rows : frozen_index_.transfers;
+    for(const auto& [bus, transfer_count] : matrix->ReachableBuses(stops, stop_ptr->id, max_transfers)){
+        result.buses.push_back({buses_[bus].name, transfer_count});
+    }
+    std::sort(result.buses.begin(), result.buses.end(), [](const ReachableBus& left, const ReachableBus& right){
+        return left.name < right.name;
+    });
+    return result;
+}
+
+std::shared_ptr<const transfers::TransferMatrix> TransportCatalogue::BusTransfers(
+    std::shared_ptr<const transfers::TransferIndex>& stop_rows) const {
+    std::lock_guard<std::mutex> lock(transfer_cache_.mutex);
+    if(transfer_cache_.version != version_){
+        transfer_cache_.stops.reset();
+        transfer_cache_.matrix.reset();
+        transfer_cache_.version = version_;
+    }
+
+    // Frozen catalogues reuse the stop rows built by Freeze
+    if(!frozen_ && transfer_cache_.stops == nullptr){
+        auto stops = std::make_shared<transfers::TransferIndex>();
+        stops->Build(BusIdsByStop(), buses_.size());
+        transfer_cache_.stops = std::move(stops);
+    }
+    const transfers::TransferIndex& stops = frozen_ ? frozen_index_.transfers : *transfer_cache_.stops;
+
+    if(transfer_cache_.matrix == nullptr){
+        auto matrix = std::make_shared<transfers::TransferMatrix>();
+        matrix->Build(stops, index_threads_);
+        transfer_cache_.matrix = std::move(matrix);
+    }
+    stop_rows = frozen_ ? nullptr : transfer_cache_.stops;
+    return transfer_cache_.matrix;
+}
+
+std::vector<std::vector<uint32_t>> TransportCatalogue::BusIdsByStop() const {
+    std::vector<std::vector<uint32_t>> result(stops_.size());
+    for(const auto& stop : stops_){
+        ForEachBusAt(&stop, [&](BusPtr bus){
+            result[stop.id].push_back(bus->id);
+        });
+    }
+    return result;
+}
+
+// ---------------- Freeze --------------------------
+void TransportCatalogue::Freeze(unsigned thread_count){
+    if(frozen_){
+        return;
+    }
+    BuildIndexes(thread_count);
+
+    FrozenIndex& index = frozen_index_;
+
+    index.bus_offsets.assign(stops_.size() + 1, 0);
+    for(const auto& [stop, buses] : bus_by_stop_){
+        index.bus_offsets[stop->id + 1] = buses.size();
+    }
+    for(size_t i = 1; i < index.bus_offsets.size(); ++i){
+        index.bus_offsets[i] += index.bus_offsets[i - 1];
+    }
+    index.buses_by_stop.resize(index.bus_offsets.back());
+    for(const auto& [stop, buses] : bus_by_stop_){
+        auto begin = index.buses_by_stop.begin() + index.bus_offsets[stop->id];
+        std::transform(buses.begin(), buses.end(), begin, [](BusPtr bus){
+            return bus->id;
+        });
+        // Queries list buses by name
+        std::sort(begin, begin + buses.size(), [this](uint32_t left, uint32_t right){
+            return buses_[left].name < buses_[right].name;
+        });
+    }
+
+    std::vector<std::pair<uint64_t, int>> road_distances;
+    road_distances.reserve(distance_between_stops_.size());
+    for(const auto& [segment, distance] : distance_between_stops_){
+        road_distances.emplace_back(SegmentKey(segment.first, segment.second), distance);
+    }
+    index.road_distances.Build(road_distances);
+
+    std::vector<std::pair<uint64_t, double>> geo_distances;
+    geo_distances.reserve(geo_distance_between_stops_.size());
+    for(const auto& [segment, length] : geo_distance_between_stops_){
+        geo_distances.emplace_back(SegmentKey(segment.first, segment.second), length);
+    }
+    index.geo_distances.Build(geo_distances);
+
+    index.route_index.assign(buses_.size(), 0);
+    for(const auto& [bus, route_index] : route_index_){
+        index.route_index[bus->id] = route_index;
+    }
+
+    BuildFrozenNames();
+    index.transfers.Build(BusIdsByStop(), buses_.size());
+    // A transfer matrix built before stays valid, its stop rows are replaced by these
+    transfer_cache_.stops.reset();
+
+    // Ingest structures are not needed anymore
+    bus_access_ = {};
+    stop_access_ = {};
+    bus_by_stop_ = {};
+    stop_by_bus_ = {};
+    distance_between_stops_ = {};
+    geo_distance_between_stops_ = {};
+    route_index_ = {};
+    frozen_ = true;
+}
+
+void TransportCatalogue::BuildFrozenNames(){
+    std::vector<std::pair<std::string_view, uint32_t>> names;
+    names.reserve(stops_.size());
+    for(const auto& stop : stops_){
+        names.emplace_back(stop.name, stop.id);
+    }
+    frozen_index_.stop_ids.Build(names);
+
+    names.clear();
+    for(const auto& bus : buses_){
+        names.emplace_back(bus.name, bus.id);
+    }
+    frozen_index_.bus_ids.Build(names);
+
+    frozen_index_.stop_names.Build(RankedStopNames());
+    frozen_index_.bus_names.Build(RankedBusNames());
+}
+
+std::vector<std::pair<std::string_view, uint32_t>> TransportCatalogue::RankedStopNames() const{
+    std::vector<std::pair<std::string_view, uint32_t>> names;
+    names.reserve(stops_.size());
+    for(const auto& stop : stops_){
+        uint32_t bus_count = 0;
+        ForEachBusAt(&stop, [&bus_count](BusPtr){
+            ++bus_count;
+        });
+        names.emplace_back(stop.name, bus_count);
+    }
+    return names;
+}
+
+std::vector<std::pair<std::string_view, uint32_t>> TransportCatalogue::RankedBusNames() const{
+    std::vector<std::pair<std::string_view, uint32_t>> names;
+    names.reserve(buses_.size());
+    std::vector<uint32_t> stop_ids;
+    for(const auto& bus : buses_){
+        stop_ids.clear();
+        for(const auto& stop : bus.stops){
+            stop_ids.push_back(stop->id);
+        }
+        std::sort(stop_ids.begin(), stop_ids.end());
+        names.emplace_back(bus.name, std::unique(stop_ids.begin(), stop_ids.end()) - stop_ids.begin());
+    }
+    return names;
+}
+
+void TransportCatalogue::Thaw(){
+    if(!frozen_){
+        return;
+    }
+    const FrozenIndex& index = frozen_index_;
+
+    for(auto& stop : stops_){
+        stop_access_.emplace(stop.name, &stop);
+        for(uint32_t i = index.bus_offsets[stop.id]; i < index.bus_offsets[stop.id + 1]; ++i){
+            bus_by_stop_[&stop].insert(&buses_[index.buses_by_stop[i]]);
+        }
+    }
+    for(const auto& bus : buses_){
+        bus_access_.emplace(bus.name, &bus);
+        if(!bus.stops.empty()){
+            route_index_.emplace(&bus, index.route_index[bus.id]);
+        }
+    }
+
+    auto segment = [this](uint64_t key){
+        return std::make_pair(static_cast<StopPtr>(&stops_[key >> 32]), static_cast<StopPtr>(&stops_[key & 0xFFFFFFFFu]));
+    };
+    distance_between_stops_.reserve(index.road_distances.Size());
+    index.road_distances.ForEach([&](uint64_t key, int distance){
+        distance_between_stops_.emplace(segment(key), distance);
+    });
+    geo_distance_between_stops_.reserve(index.geo_distances.Size());
+    index.geo_distances.ForEach([&](uint64_t key, double length){
+        geo_distance_between_stops_.emplace(segment(key), length);
+    });
+
+    frozen_index_ = {};
+    frozen_ = false;
+}
+
+bool TransportCatalogue::IsFrozen() const{
+    return frozen_;
+}
+
+void TransportCatalogue::CheckWritable() const{
+    if(frozen_){
+        throw std::logic_error("Catalogue is frozen");
+    }
+}
+
+// ---------------- Lookups --------------------------
+StopPtr TransportCatalogue::LookupStop(std::string_view name) const{
+    if(frozen_){
+        const uint32_t* id = frozen_index_.stop_ids.Find(name);
+        return id == nullptr ? nullptr : &stops_[*id];
+    }
+    auto it = stop_access_.find(name);
+    return it == stop_access_.end() ? nullptr : it->second;
+}
+
+BusPtr TransportCatalogue::LookupBus(std::string_view name) const{
+    if(frozen_){
+        const uint32_t* id = frozen_index_.bus_ids.Find(name);
+        return id == nullptr ? nullptr : &buses_[*id];
+    }
+    auto it = bus_access_.find(name);
+    return it == bus_access_.end() ? nullptr : it->second;
+}
+
+int TransportCatalogue::RoadDistance(StopPtr from, StopPtr to) const{
+    if(frozen_){
+        const int* distance = frozen_index_.road_distances.Find(SegmentKey(from, to));
+        if(distance == nullptr){
+            throw std::out_of_range("No road distance from "s + from->name + " to "s + to->name);
+        }
+        return *distance;
+    }
+    return distance_between_stops_.at(std::make_pair(from, to));
+}
+
+double TransportCatalogue::GeoDistance(StopPtr from, StopPtr to) const{
+    if(frozen_){
+        const double* length = frozen_index_.geo_distances.Find(SegmentKey(from, to));
+        if(length == nullptr){
+            throw std::out_of_range("No geo distance from "s + from->name + " to "s + to->name);
+        }
+        return *length;
+    }
+    return geo_distance_between_stops_.at(std::make_pair(from, to));
+}
+
+// ---------------- Trips --------------------------
+bool TransportCatalogue::IsTripIndexed(BusPtr bus) const{
+    return bus->id + 1 < trip_offsets_.size();
+}
+
+int TransportCatalogue::TripRoadLength(BusPtr bus, size_t from, size_t to) const{
+    if(IsTripIndexed(bus)){
+        const size_t offset = trip_offsets_[bus->id];
+        const int from_length = trip_road_lengths_[offset + from];
+        const int to_length = trip_road_lengths_[offset + to];
+        if(from_length >= 0 && to_length >= 0){
+            return to_length - from_length;
+        }
+    }
+
+    // Not indexed yet or a road distance is missing, which throws
+    int length = 0;
+    for(size_t i = from; i < to; ++i){
+        length += RoadDistance(RouteStop(*bus, i), RouteStop(*bus, i + 1));
+    }
+    return length;
+}
+
+double TransportCatalogue::TripGeoLength(BusPtr bus, size_t from, size_t to) const{
+    if(IsTripIndexed(bus)){
+        const size_t offset = trip_offsets_[bus->id];
+        return trip_geo_lengths_[offset + to] - trip_geo_lengths_[offset + from];
+    }
+
+    double length = 0;
+    for(size_t i = from; i < to; ++i){
+        length += GeoDistance(RouteStop(*bus, i), RouteStop(*bus, i + 1));
+    }
+    return length;
+}
+
+std::optional<size_t> TransportCatalogue::FindTripPosition(BusPtr bus, uint32_t stop_id, size_t first_position) const{
+    if(IsTripIndexed(bus)){
+        auto begin = trip_stop_positions_.begin() + trip_offsets_[bus->id];
+        auto end = trip_stop_positions_.begin() + trip_offsets_[bus->id + 1];
+        auto it = std::lower_bound(begin, end, std::make_pair(stop_id, static_cast<uint32_t>(first_position)));
+        if(it == end || it->first != stop_id){
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    for(size_t position = first_position; position < RouteStopCount(*bus); ++position){
+        if(RouteStop(*bus, position)->id == stop_id){
+            return position;
+        }
+    }
+    return std::nullopt;
+}
+
+RouteSegment TransportCatalogue::TripSegment(BusPtr bus, size_t from, size_t to) const{
+    if(from > to || to >= RouteStopCount(*bus)){
+        return {};
+    }
+    return {true, TripRoadLength(bus, from, to), static_cast<int>(to - from + 1)};
+}
+
+size_t TransportCatalogue::RouteIndex(BusPtr bus) const{
+    if(frozen_){
+        return frozen_index_.route_index[bus->id];
+    }
+    return route_index_.at(bus);
+}
+
+memory::Report TransportCatalogue::GetMemoryUsage()const{
+    memory::Report report;
+
+    size_t stops = memory::HeapUsage(stops_);
+    for(const auto& stop : stops_){
+        stops += memory::HeapUsage(stop.name);
+    }
+    report["stops"] = stops;
+
+    size_t buses = memory::HeapUsage(buses_);
+    for(const auto& bus : buses_){
+        buses += memory::HeapUsage(bus.name) + memory::HeapUsage(bus.stops);
+    }
+    report["buses"] = buses;
+
+    report["bus_access"] = memory::HeapUsage(bus_access_);
+    report["stop_access"] = memory::HeapUsage(stop_access_);
+
+    size_t bus_by_stop = memory::HeapUsage(bus_by_stop_);
+    for(const auto& [stop, buses] : bus_by_stop_){
+        bus_by_stop += memory::HeapUsage(buses);
+    }
+    report["bus_by_stop"] = bus_by_stop;
+
+    size_t stop_by_bus = memory::HeapUsage(stop_by_bus_);
+    for(const auto& [bus, stops] : stop_by_bus_){
+        stop_by_bus += memory::HeapUsage(stops);
+    }
+    report["stop_by_bus"] = stop_by_bus;
+
+    report["distance_between_stops"] = memory::HeapUsage(distance_between_stops_);
+    report["geo_distance_between_stops"] = memory::HeapUsage(geo_distance_between_stops_);
+    report["stop_coordinates"] = 2 * memory::AllocationSize(stop_coordinates_.Size() * sizeof(geo::CoordinateTable::Value));
+    report["stop_trig"] = 3 * memory::AllocationSize(stop_trig_.Size() * sizeof(double));
+    report["stop_index"] = memory::AllocationSize(stop_index_.Size() * sizeof(StopPtr))
+                         + 2 * memory::AllocationSize(stop_index_.Size() * sizeof(double));
+    report["route_index"] = memory::HeapUsage(route_index_);
+    report["bus_bounds"] = memory::HeapUsage(bus_bounds_);
+    report["trip_lengths"] = memory::HeapUsage(trip_offsets_) + memory::HeapUsage(trip_road_lengths_)
+                           + memory::HeapUsage(trip_geo_lengths_) + memory::HeapUsage(trip_stop_positions_);
+
+    if(frozen_){
+        report["frozen_names"] = frozen_index_.stop_ids.HeapUsage() + frozen_index_.bus_ids.HeapUsage();
+        report["frozen_prefix_index"] = frozen_index_.stop_names.HeapUsage() + frozen_index_.bus_names.HeapUsage();
+        report["frozen_bus_adjacency"] = memory::HeapUsage(frozen_index_.bus_offsets)
+                                       + memory::HeapUsage(frozen_index_.buses_by_stop);
+        report["frozen_road_distances"] = frozen_index_.road_distances.HeapUsage();
+        report["frozen_geo_distances"] = frozen_index_.geo_distances.HeapUsage();
+        report["frozen_route_index"] = memory::HeapUsage(frozen_index_.route_index);
+        report["frozen_transfers"] = frozen_index_.transfers.HeapUsage();
+    }
+    {
+        std::lock_guard<std::mutex> lock(transfer_cache_.mutex);
+        if(transfer_cache_.stops != nullptr){
+            report["transfer_stop_rows"] = transfer_cache_.stops->HeapUsage();
+        }
+        if(transfer_cache_.matrix != nullptr){
+            report["transfers"] = transfer_cache_.matrix->HeapUsage();
+        }
+    }
+
+    return report;
 }
 }
@@ -1,23 +1,42 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <set>
+#include <stdexcept>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
 
 #include "../src/domain.h"
+#include "../src/flat_hash_map.h"
 #include "../src/geo.h"
+#include "../src/memory_usage.h"
+#include "../src/parallel.h"
+#include "../src/perfect_hash.h"
+#include "../src/prefix_index.h"
+#include "../src/spatial_index.h"
+#include "../src/transfer_index.h"
 
 namespace transport_catalogue{
 using namespace entities;
 
 class TransportCatalogue{
 public:
+    TransportCatalogue() = default;
+    // Deep copy, every internal pointer is redirected to the copied stops and buses
+    TransportCatalogue(const TransportCatalogue& other);
+    TransportCatalogue& operator=(const TransportCatalogue& other);
+    TransportCatalogue(TransportCatalogue&& other) = default;
+    TransportCatalogue& operator=(TransportCatalogue&& other) = default;
+
     void AddBus(const std::string& bus, std::vector<std::string> stops, bool roundtrip);
     void AddStop(const std::string& stop);
     void AddStop(const std::string& stop, const geo::Coordinates& coordinates);
@@ -25,12 +44,137 @@ public:
     void SetDistanceBetweenStops(const std::string& stop,
                                  const std::vector<std::pair<std::string, int>>& distance_to_stops);
 
+    // Builds the stop-to-bus index, road and geographic distance tables for everything added since
+    // the previous call, and rebuilds the spatial indexes. Queries see new buses and distances only after it.
+    // Indexes built later on demand use the same thread count
+    void BuildIndexes(unsigned thread_count = parallel::DefaultThreadCount());
+
+    // Replaces the ingest structures with compact read-only ones: flat hash tables for names and
+    // distances, buses of every stop in one array. Writes to a frozen catalogue throw std::logic_error
+    void Freeze(unsigned thread_count = parallel::DefaultThreadCount());
+    // Brings the ingest structures back, so the catalogue accepts writes again
+    void Thaw();
+    bool IsFrozen() const;
+
 public:
     std::vector<StopPtr> FindBusRoute(const std::string& bus) const;
     StopPtr FindStop(const std::string& bus_stop) const;
     StopBusList StopInformation(const std::string& stop) const;
     BusRoute RouteInformation(const std::string& bus) const;
+    // Road distance and stops from position from to position to of the whole trip, positions
+    // count from 0 and the way back of a bus that is not circular continues them. O(1) once indexed
+    RouteSegment SegmentInformation(const std::string& bus, size_t from, size_t to) const;
+    // Same from the first visit of stop from to the next visit of stop to
+    RouteSegment SegmentInformation(const std::string& bus, const std::string& from, const std::string& to) const;
     std::vector<BusRouteRenderInfo> GetRenderData()const;
+    ViewportRenderInfo GetRenderData(const spatial::BoundingBox& box)const;
+    spatial::BoundingBox GetRouteBounds()const;
+    // Stop locations indexed by stop id
+    const geo::CoordinateTable& GetStopCoordinates()const;
+    uint64_t GetVersion()const;
+    // Every stop and bus in the order they were added, positions are their ids
+    const std::deque<Stop>& GetStops()const;
+    const std::deque<Bus>& GetBuses()const;
+
+    // Heap bytes per internal structure
+    memory::Report GetMemoryUsage()const;
+
+    std::vector<NearbyStop> FindNearestStops(const geo::Coordinates& point, size_t count) const;
+    AreaObjectList AreaInformation(const spatial::BoundingBox& box) const;
+    // First count stops and buses whose names start with name_prefix, most connected first.
+    // Answered from an index built by Freeze, a catalogue that is not frozen builds it per call
+    NameSuggestions FindByPrefix(std::string_view name_prefix, size_t count) const;
+    // Buses serving both stops
+    CommonBusList CommonBuses(const std::string& from, const std::string& to) const;
+    // Buses boarded at the stop or reached from it with at most max_transfers changes, with the
+    // fewest changes each. Answered from a bus transfer matrix built by the first call and kept
+    // until the catalogue changes
+    TransferReach ReachableBuses(const std::string& stop, size_t max_transfers) const;
+
+private:
+    struct DistanceRecord{
+        StopPtr from;
+        StopPtr to;
+        int distance;
+    };
+
+    // Each index is built in shards, one per thread, which are then merged into the main table
+    void IndexBusStops(size_t first_bus, unsigned thread_count);
+    void IndexRoadDistances(unsigned thread_count);
+    void IndexSegmentLengths(size_t first_bus, unsigned thread_count);
+
+    // Cumulative distances along every whole trip, rebuilt in full
+    void IndexTrips(unsigned thread_count);
+
+    // Recomputes geographic lengths of an indexed bus after one of its stops was moved
+    void RefreshSegmentLengths(const Bus& bus);
+
+    void CheckWritable() const;
+    void BuildFrozenNames();
+    // Names with the rank autocomplete orders them by
+    std::vector<std::pair<std::string_view, uint32_t>> RankedStopNames() const;
+    std::vector<std::pair<std::string_view, uint32_t>> RankedBusNames() const;
+    // Ids of the buses at every stop, by stop id
+    std::vector<std::vector<uint32_t>> BusIdsByStop() const;
+
+    // Read paths that work both before and after Freeze
+    StopPtr LookupStop(std::string_view name) const; // nullptr for an unknown stop
+    BusPtr LookupBus(std::string_view name) const; // nullptr for an unknown bus
+    int RoadDistance(StopPtr from, StopPtr to) const;
+    double GeoDistance(StopPtr from, StopPtr to) const;
+    size_t RouteIndex(BusPtr bus) const;
+
+    // Along a trip, from the indexed lengths when possible
+    bool IsTripIndexed(BusPtr bus) const;
+    int TripRoadLength(BusPtr bus, size_t from, size_t to) const;
+    double TripGeoLength(BusPtr bus, size_t from, size_t to) const;
+    // First position at or after first_position where the trip visits the stop
+    std::optional<size_t> FindTripPosition(BusPtr bus, uint32_t stop_id, size_t first_position) const;
+    RouteSegment TripSegment(BusPtr bus, size_t from, size_t to) const;
+    template <typename Visitor>
+    void ForEachBusAt(StopPtr stop, Visitor visitor) const;
+
+    struct FrozenIndex{
+        // The name sets are fixed, one probe and one compare per lookup
+        flat::PerfectHashMap<uint32_t> stop_ids;
+        flat::PerfectHashMap<uint32_t> bus_ids;
+        prefix::PrefixIndex stop_names;
+        prefix::PrefixIndex bus_names;
+
+        // Buses of stop i, by bus id, are buses_by_stop[bus_offsets[i] .. bus_offsets[i + 1])
+        std::vector<uint32_t> bus_offsets;
+        std::vector<uint32_t> buses_by_stop;
+
+        // Keyed by SegmentKey of the stop pair
+        flat::FlatHashMap<uint64_t, int, flat::IntegerHasher> road_distances;
+        flat::FlatHashMap<uint64_t, double, flat::IntegerHasher> geo_distances;
+
+        std::vector<uint32_t> route_index; // by bus id
+
+        transfers::TransferIndex transfers; // stop rows only, for CommonBuses
+    };
+
+    // Transfer matrix for ReachableBuses, shared by the readers of one catalogue version.
+    // A copy starts empty, the mutex is not copyable and the matrix is cheap to rebuild
+    struct TransferCache{
+        TransferCache() = default;
+        TransferCache(const TransferCache&){}
+        TransferCache& operator=(const TransferCache&){
+            stops.reset();
+            matrix.reset();
+            return *this;
+        }
+
+        std::mutex mutex;
+        uint64_t version = 0;
+        // Stop rows of a catalogue that is not frozen, a frozen one has them in frozen_index_
+        std::shared_ptr<const transfers::TransferIndex> stops;
+        std::shared_ptr<const transfers::TransferMatrix> matrix;
+    };
+
+    // Null stop_rows means the rows of frozen_index_
+    std::shared_ptr<const transfers::TransferMatrix> BusTransfers(
+        std::shared_ptr<const transfers::TransferIndex>& stop_rows) const;
 
 private:
     std::deque<Bus> buses_;
@@ -43,6 +187,51 @@ private:
     std::unordered_map<BusPtr, std::unordered_set<StopPtr>> stop_by_bus_;
 
     std::unordered_map<std::pair<StopPtr, StopPtr>, int, hashers::StopDistanceHasher> distance_between_stops_;
+    std::unordered_map<std::pair<StopPtr, StopPtr>, double, hashers::StopDistanceHasher> geo_distance_between_stops_;
+    geo::CoordinateTable stop_coordinates_;
+    geo::TrigTable stop_trig_;
+
+    // Writes waiting for the next BuildIndexes
+    std::vector<DistanceRecord> pending_distances_;
+    size_t indexed_bus_count_ = 0;
+
+    // Whole trips of all buses back to back, the trip of bus i is at trip_offsets_[i] .. trip_offsets_[i + 1].
+    // Lengths run from the first stop of the trip, -1 from a segment without road distance on
+    std::vector<uint32_t> trip_offsets_;
+    std::vector<int> trip_road_lengths_;
+    std::vector<double> trip_geo_lengths_;
+    // (stop id, position) of every stop of a trip, sorted
+    std::vector<std::pair<uint32_t, uint32_t>> trip_stop_positions_;
+
+    spatial::StopIndex stop_index_;
+    std::unordered_map<BusPtr, size_t> route_index_;
+    spatial::BoundingBox route_bounds_ = {};
+    std::vector<spatial::BoundingBox> bus_bounds_; // by bus id, of the stops of every indexed bus
+
+    bool frozen_ = false;
+    FrozenIndex frozen_index_;
+
+    // Incremented by every write, lets caches tell stale results apart
+    uint64_t version_ = 0;
+    unsigned index_threads_ = parallel::DefaultThreadCount();
+    mutable TransferCache transfer_cache_;
 };
 
+template <typename Visitor>
+void TransportCatalogue::ForEachBusAt(StopPtr stop, Visitor visitor) const {
+    if(frozen_){
+        for(uint32_t i = frozen_index_.bus_offsets[stop->id]; i < frozen_index_.bus_offsets[stop->id + 1]; ++i){
+            visitor(static_cast<BusPtr>(&buses_[frozen_index_.buses_by_stop[i]]));
+        }
+        return;
+    }
+    auto it = bus_by_stop_.find(stop);
+    if(it == bus_by_stop_.end()){
+        return;
+    }
+    for(const auto& bus : it->second){
+        visitor(bus);
+    }
+}
+
 }
@@ -0,0 +1,29 @@
+#include "../src/versioned_catalogue.h"
+
+namespace transport_catalogue{
+
+VersionedCatalogue::VersionedCatalogue()
+    : current_(std::make_shared<const TransportCatalogue>()){
+}
+
+VersionedCatalogue::VersionedCatalogue(TransportCatalogue catalogue)
+    : current_(std::make_shared<const TransportCatalogue>(std::move(catalogue))){
+}
+
+VersionedCatalogue::Snapshot VersionedCatalogue::GetSnapshot() const{
+    return std::atomic_load(&current_);
+}
+
+VersionedCatalogue::Snapshot VersionedCatalogue::Replace(TransportCatalogue catalogue){
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+
+    auto next = std::make_shared<const TransportCatalogue>(std::move(catalogue));
+    Publish(next);
+    return next;
+}
+
+void VersionedCatalogue::Publish(const Snapshot& snapshot){
+    std::atomic_store(&current_, snapshot);
+}
+
+}
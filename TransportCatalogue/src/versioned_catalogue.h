@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "../src/transport_catalogue.h"
+
+namespace transport_catalogue{
+
+// Read-copy-update holder of the catalogue. Readers take an immutable snapshot and query it
+// without locks for as long as they need, a writer changes a private copy and publishes it as
+// the next version. A version is freed when the last snapshot of it is released.
+class VersionedCatalogue{
+public:
+    using Snapshot = std::shared_ptr<const TransportCatalogue>;
+
+    VersionedCatalogue();
+    explicit VersionedCatalogue(TransportCatalogue catalogue);
+
+    Snapshot GetSnapshot() const;
+
+    // Applies updater to a copy of the latest version, rebuilds its indexes and publishes it.
+    // A frozen version is thawed for the update and frozen again before publishing.
+    // Writers are serialized with each other, readers keep using the previous version meanwhile
+    template <typename Updater>
+    Snapshot Update(Updater updater);
+
+    // Publishes a catalogue built elsewhere as the next version
+    Snapshot Replace(TransportCatalogue catalogue);
+
+private:
+    void Publish(const Snapshot& snapshot);
+
+private:
+    Snapshot current_;
+    std::mutex writer_mutex_;
+};
+
+template <typename Updater>
+VersionedCatalogue::Snapshot VersionedCatalogue::Update(Updater updater){
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+
+    auto next = std::make_shared<TransportCatalogue>(*GetSnapshot());
+    const bool frozen = next->IsFrozen();
+    next->Thaw();
+    updater(*next);
+    next->BuildIndexes();
+    if(frozen){
+        next->Freeze();
+    }
+
+    Publish(next);
+    return next;
+}
+
+}